@@ -0,0 +1,64 @@
+#ifndef tp_boj_BOJInfo_h
+#define tp_boj_BOJInfo_h
+
+#include "tp_boj/ReadBOJ.h"
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Bounds and counts for a mesh or a whole object.
+/*!
+The sphere is centered on the bounding box, it is cheap to calculate but not the smallest sphere.
+Everything is zero for a mesh without vertices.
+*/
+struct Bounds
+{
+  glm::vec3 min{0.0f, 0.0f, 0.0f};
+  glm::vec3 max{0.0f, 0.0f, 0.0f};
+  glm::vec3 center{0.0f, 0.0f, 0.0f};
+  float radius{0.0f};
+
+  size_t verts{0};
+  size_t triangles{0}; //!< Including those in strips and fans.
+};
+
+//##################################################################################################
+//! Bounds and counts for a file, see readBOJInfo.
+struct BOJInfo
+{
+  uint32_t version{0};
+  size_t meshCount{0};
+
+  //! True if the bounds came from the header, false if the file had to be decoded to get them.
+  bool fromHeader{false};
+
+  Bounds total;
+  std::vector<Bounds> meshes;
+};
+
+//##################################################################################################
+//! Calculate the bounds of a single mesh.
+Bounds calculateBounds(const tp_math_utils::Geometry3D& mesh);
+
+//##################################################################################################
+//! Combine the bounds of several meshes, the sphere encloses the sphere of each mesh.
+Bounds combineBounds(const std::vector<Bounds>& meshes);
+
+//##################################################################################################
+//! Read the bounds of each mesh in a file without reading its geometry.
+/*!
+Version 26+ files store the bounds in the header so only the start of the file is read. Older files
+are decoded to calculate the bounds.
+
+\returns false if the file could not be read, in which case error is filled in if it is set.
+*/
+bool readBOJInfo(const std::string& filePath, BOJInfo& info, ReadError* error=nullptr);
+
+//##################################################################################################
+//! Read the bounds of each mesh from data in memory, see readBOJInfo.
+bool readBOJInfo(const char* data, size_t size, BOJInfo& info, ReadError* error=nullptr);
+
+}
+
+#endif
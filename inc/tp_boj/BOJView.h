@@ -0,0 +1,149 @@
+#ifndef tp_boj_BOJView_h
+#define tp_boj_BOJView_h
+
+#include "tp_boj/ReadBOJ.h"
+
+#include <string_view>
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! A vertex as it is stored in a version 28+ file, 8 little endian floats.
+struct PackedVertex
+{
+  float vert[3];
+  float texture[2];
+  float normal[3];
+};
+
+static_assert(sizeof(PackedVertex)==32, "PackedVertex must match the file layout.");
+
+//##################################################################################################
+//! How the indexes of an IndexArrayView form triangles, these are the values stored in the file.
+enum class IndexArrayType
+{
+  TriangleFan   = 1,
+  TriangleStrip = 2,
+  Triangles     = 3
+};
+
+//##################################################################################################
+//! An array of indexes that points into the file.
+struct IndexArrayView
+{
+  IndexArrayType type{IndexArrayType::Triangles};
+  const void* data{nullptr}; //!< count indexes of width bytes each.
+  size_t count{0};
+  size_t width{4};           //!< 1, 2, or 4 bytes.
+
+  //################################################################################################
+  uint32_t operator[](size_t i) const
+  {
+    auto p = static_cast<const uint8_t*>(data) + i*width;
+    switch(width)
+    {
+      case 1:  return *p;
+      case 2:  return *reinterpret_cast<const uint16_t*>(p);
+      default: return *reinterpret_cast<const uint32_t*>(p);
+    }
+  }
+};
+
+//##################################################################################################
+//! The vertices and indexes of one level of detail of a mesh.
+/*!
+Geometry that was written with compression or delta encoded indexes can't be used in place, for
+those inPlace is false, the pointers are null, and BOJView::decode must be used instead.
+*/
+struct GeometryView
+{
+  bool inPlace{false};
+
+  const PackedVertex* verts{nullptr}; //!< Aligned to 64 bytes from the start of the file.
+  size_t vertCount{0};
+
+  std::vector<IndexArrayView> indexArrays;
+};
+
+//##################################################################################################
+//! A mesh in a BOJView, the comments point into the file.
+struct MeshView
+{
+  size_t materialIndex{0};
+  std::vector<std::string_view> comments;
+
+  //! The full resolution mesh followed by progressively coarser levels of detail.
+  std::vector<GeometryView> lods;
+};
+
+//##################################################################################################
+//! A read only view of a version 28+ .boj file that uses its vertices and indexes in place.
+/*!
+Opening a view walks the header and the structure of each mesh, the vertices and indexes are never
+read or copied so opening is proportional to the number of meshes rather than the size of the file.
+Materials are only decoded the first time that they are requested.
+
+The view is immutable once it is open and every method can be called concurrently. Vertices and
+indexes are read in the byte order of the host, like the rest of the reader this assumes that it is
+little endian.
+*/
+class TP_BOJ_EXPORT BOJView
+{
+  TP_NONCOPYABLE(BOJView);
+public:
+  //################################################################################################
+  //! Map filePath and view it, the file stays mapped for the lifetime of the view.
+  BOJView(const std::string& filePath);
+
+  //################################################################################################
+  //! View data owned by the caller, it must outlive the view and be aligned to at least 4 bytes.
+  /*!
+  The vertices and indexes are only aligned to 64 bytes in memory if data is.
+  */
+  BOJView(const char* data, size_t size);
+
+  //################################################################################################
+  ~BOJView();
+
+  //################################################################################################
+  //! Returns true if the data is a valid version 28+ file, otherwise see error.
+  bool isValid() const;
+
+  //################################################################################################
+  const ReadError& error() const;
+
+  //################################################################################################
+  uint32_t version() const;
+
+  //################################################################################################
+  size_t meshCount() const;
+
+  //################################################################################################
+  const MeshView& mesh(size_t meshIndex) const;
+
+  //################################################################################################
+  size_t materialCount() const;
+
+  //################################################################################################
+  //! Returns the material decoding it the first time that it is requested.
+  const tp_math_utils::Material& material(size_t materialIndex) const;
+
+  //################################################################################################
+  //! Decode a level of detail of a mesh into a Geometry3D, this works for compressed geometry.
+  /*!
+  Meshes with fewer levels decode their coarsest.
+
+  \returns false if the geometry could not be decoded, in which case error is filled in if it is set.
+  */
+  bool decode(size_t meshIndex, size_t lod, tp_math_utils::Geometry3D& mesh, ReadError* error=nullptr) const;
+
+private:
+  struct Private;
+  friend struct Private;
+  Private* d;
+};
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef tp_boj_BatchReadBOJ_h
+#define tp_boj_BatchReadBOJ_h
+
+#include "tp_boj/ReadBOJ.h"
+
+#include <future>
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Options that control how a BatchReader loads files.
+struct BatchReadOptions
+{
+  //! Options used to read each file, stats and error are ignored see BatchReadResult instead.
+  /*!
+  Files are already read in parallel so readOptions.maxThreads is usually best left at 1.
+  */
+  ReadOptions readOptions;
+
+  //! The number of files decoded at the same time, 0 will use one per core.
+  size_t maxThreads{0};
+
+  //! The number of files that are mapped and being read ahead of decoding, 0 will use 2*maxThreads.
+  /*!
+  This limits both the outstanding disk reads and the memory held by mapped files.
+  */
+  size_t maxInFlight{0};
+
+  //! If true BatchReadResult::stats will be filled in for each file.
+  bool collectStats{false};
+};
+
+//##################################################################################################
+//! The result of loading a single file with a BatchReader.
+struct BatchReadResult
+{
+  std::string filePath;
+  std::vector<tp_math_utils::Geometry3D> object;
+
+  //! The textures used by this file, these are also merged into BatchReader::texturePaths().
+  std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+
+  ReadError error; //!< error.reason is empty if the file was read.
+  ReadStats stats; //!< Only filled if BatchReadOptions::collectStats is set.
+};
+
+//##################################################################################################
+//! Load many .boj files concurrently on a pool of threads.
+/*!
+Files are queued with load() and decoded in the order they were queued. Before a file is decoded
+it is mapped and the OS is asked to read it ahead, up to maxInFlight files at a time, so that disk
+reads overlap with decoding other files.
+
+The texture paths from every file are merged into a single map that can be read with
+texturePaths() once the files have loaded.
+
+\code
+tp_boj::BatchReader reader(extractTextureIDs);
+std::vector<std::future<tp_boj::BatchReadResult>> results;
+for(const auto& path : paths)
+  results.push_back(reader.load(path));
+\endcode
+*/
+class TP_BOJ_EXPORT BatchReader
+{
+  TP_NONCOPYABLE(BatchReader);
+public:
+  //################################################################################################
+  BatchReader(const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+              const BatchReadOptions& options=BatchReadOptions());
+
+  //################################################################################################
+  //! Waits for all queued files to load.
+  ~BatchReader();
+
+  //################################################################################################
+  //! Queue a file to be loaded, the result is available from the future once it has loaded.
+  std::future<BatchReadResult> load(const std::string& filePath);
+
+  //################################################################################################
+  //! Queue a file to be loaded, loaded is called from one of the pool threads once it has loaded.
+  /*!
+  loaded may be called concurrently for different files so it must be thread safe.
+  */
+  void load(const std::string& filePath, const std::function<void(BatchReadResult&)>& loaded);
+
+  //################################################################################################
+  //! Block until every queued file has loaded and every callback has returned.
+  void wait();
+
+  //################################################################################################
+  //! Returns the texture paths merged from every file that has loaded so far.
+  std::unordered_map<tp_utils::StringID, std::string> texturePaths() const;
+
+private:
+  struct Private;
+  friend struct Private;
+  Private* d;
+};
+
+//##################################################################################################
+//! Load many files concurrently and return them in the same order as filePaths.
+/*!
+This is a convenience wrapper around BatchReader, files that fail to load will be empty.
+*/
+std::vector<std::vector<tp_math_utils::Geometry3D>> readObjectsAndTexturesFromFiles(const std::vector<std::string>& filePaths,
+                                                                                  std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                                                                  const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                                                                  const BatchReadOptions& options=BatchReadOptions());
+}
+
+#endif
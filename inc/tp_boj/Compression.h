@@ -0,0 +1,27 @@
+#ifndef tp_boj_Compression_h
+#define tp_boj_Compression_h
+
+#include "tp_boj/Globals.h" // IWYU pragma: keep
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Compress a chunk of .boj data.
+/*!
+The bytes of each 4 byte word are shuffled into 4 planes so that the exponents and high bytes of
+floats and indexes sit next to each other, then the planes are compressed using a byte oriented
+LZ77 codec with the same token layout as LZ4. This is built for decode speed not ratio.
+*/
+std::string compressChunk(const char* data, size_t size);
+
+//##################################################################################################
+//! Decompress a chunk compressed with compressChunk into output.
+/*!
+\returns false if the data is corrupt or does not decompress to exactly outputSize bytes.
+*/
+bool decompressChunk(const char* data, size_t size, char* output, size_t outputSize);
+
+}
+
+#endif
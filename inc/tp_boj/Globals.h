@@ -3,6 +3,9 @@
 
 #include "tp_utils/StringID.h"
 
+#include <functional>
+#include <chrono>
+
 #if defined(TP_BOJ_LIBRARY)
 #  define TP_BOJ_EXPORT TP_EXPORT
 #else
@@ -19,6 +22,39 @@ std::string cleanTextureName(const tp_utils::StringID& name);
 //##################################################################################################
 std::string getAssociatedFilePath(const std::string& filePath, const std::string& filename=std::string());
 
+//##################################################################################################
+//! Call fn for each index in [0, count) using up to maxThreads threads, 0 will use one per core.
+/*!
+fn must not throw, the calling thread is used as one of the workers and this returns once every
+index has been processed.
+*/
+void parallelFor(size_t count, size_t maxThreads, const std::function<void(size_t)>& fn);
+
+//##################################################################################################
+//! Adds the wall time between construction and destruction to seconds, does nothing if it is null.
+struct ScopedTimer
+{
+  TP_NONCOPYABLE(ScopedTimer);
+
+  double* seconds;
+  std::chrono::steady_clock::time_point start;
+
+  //################################################################################################
+  ScopedTimer(double* seconds_):
+    seconds(seconds_)
+  {
+    if(seconds)
+      start = std::chrono::steady_clock::now();
+  }
+
+  //################################################################################################
+  ~ScopedTimer()
+  {
+    if(seconds)
+      *seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+};
+
 }
 
 #endif
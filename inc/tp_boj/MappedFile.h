@@ -0,0 +1,50 @@
+#ifndef tp_boj_MappedFile_h
+#define tp_boj_MappedFile_h
+
+#include "tp_boj/Globals.h" // IWYU pragma: keep
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Read only memory mapping of a file.
+/*!
+This is used to decode .boj files straight from the page cache rather than first copying them into
+a std::string. On platforms without mmap the file is read into memory instead.
+*/
+class TP_BOJ_EXPORT MappedFile
+{
+  TP_NONCOPYABLE(MappedFile);
+public:
+  //################################################################################################
+  MappedFile(const std::string& filePath);
+
+  //################################################################################################
+  ~MappedFile();
+
+  //################################################################################################
+  //! Returns true if the file was opened, an empty file is valid.
+  bool isValid() const;
+
+  //################################################################################################
+  //! Ask the OS to start reading the whole file into memory without waiting for it.
+  /*!
+  Use this when a file will be decoded soon so that the disk read overlaps with other work.
+  */
+  void willNeed() const;
+
+  //################################################################################################
+  const char* data() const;
+
+  //################################################################################################
+  size_t size() const;
+
+private:
+  struct Private;
+  friend struct Private;
+  Private* d;
+};
+
+}
+
+#endif
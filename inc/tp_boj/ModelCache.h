@@ -0,0 +1,91 @@
+#ifndef tp_boj_ModelCache_h
+#define tp_boj_ModelCache_h
+
+#include "tp_boj/ReadBOJ.h"
+
+#include <memory>
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! A file loaded by a ModelCache, this is shared between every caller that loaded it.
+struct CachedModel
+{
+  std::vector<tp_math_utils::Geometry3D> object;
+  std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+
+  ReadError error; //!< error.reason is empty if the file was read.
+
+  //! Estimated memory used by object including its materials, and by texturePaths, this is what
+  //! counts towards maxBytes.
+  size_t bytes{0};
+};
+
+//##################################################################################################
+//! Options that control how a ModelCache loads and evicts files.
+struct ModelCacheOptions
+{
+  //! Least recently used models are evicted when the cached models use more than this.
+  size_t maxBytes{size_t(512)<<20};
+
+  //! Options used to load every file, stats and error are ignored see CachedModel::error instead.
+  ReadOptions readOptions;
+};
+
+//##################################################################################################
+//! Counts collected by a ModelCache.
+struct ModelCacheStats
+{
+  size_t hits{0};      //!< Calls to load that returned a cached or in flight model.
+  size_t misses{0};    //!< Calls to load that read the file.
+  size_t evictions{0}; //!< Models evicted to stay within maxBytes.
+  size_t models{0};    //!< Models currently cached.
+  size_t bytes{0};     //!< Estimated memory used by the cached models.
+};
+
+//##################################################################################################
+//! Thread safe cache of loaded .boj files.
+/*!
+Files are keyed by their canonical path, a file is loaded again if its size or modification time
+has changed since it was cached. When several threads load a file that is not cached only one of
+them reads it, the others wait for that load to complete and share the result.
+
+Models are returned as shared immutable objects, eviction only drops the cache's reference so a
+model stays valid for as long as the caller holds it. Files that fail to load are not cached.
+*/
+class TP_BOJ_EXPORT ModelCache
+{
+  TP_NONCOPYABLE(ModelCache);
+public:
+  //################################################################################################
+  ModelCache(const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+             const ModelCacheOptions& options=ModelCacheOptions());
+
+  //################################################################################################
+  ~ModelCache();
+
+  //################################################################################################
+  //! Returns the model for filePath loading it if required, this never returns null.
+  std::shared_ptr<const CachedModel> load(const std::string& filePath);
+
+  //################################################################################################
+  //! Drop the cached model for filePath, it will be loaded again the next time it is requested.
+  void remove(const std::string& filePath);
+
+  //################################################################################################
+  //! Drop every cached model.
+  void clear();
+
+  //################################################################################################
+  ModelCacheStats stats() const;
+
+private:
+  struct Private;
+  friend struct Private;
+  Private* d;
+};
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef tp_boj_OptimizeMesh_h
+#define tp_boj_OptimizeMesh_h
+
+#include "tp_boj/Globals.h" // IWYU pragma: keep
+
+#include "tp_math_utils/Geometry3D.h"
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Stats collected by optimizeMesh, these accumulate when passed to multiple calls.
+struct OptimizeStats
+{
+  size_t meshes{0};
+  size_t vertsBefore{0};
+  size_t vertsAfter{0};
+  size_t triangles{0};
+
+  //! Post transform cache misses simulated with a FIFO cache of vertexCacheSize entries.
+  size_t cacheMissesBefore{0};
+  size_t cacheMissesAfter{0};
+
+  //################################################################################################
+  //! Average cache miss ratio, the number of vertices transformed per triangle.
+  float acmrBefore() const
+  {
+    return triangles?float(cacheMissesBefore)/float(triangles):0.0f;
+  }
+
+  //################################################################################################
+  float acmrAfter() const
+  {
+    return triangles?float(cacheMissesAfter)/float(triangles):0.0f;
+  }
+};
+
+//##################################################################################################
+//! The size of the post transform vertex cache that the optimizer targets.
+constexpr size_t vertexCacheSize = 16;
+
+//##################################################################################################
+//! Optimize a mesh for GPU rendering and file size.
+/*!
+This will:
+ - Weld vertices that are bitwise identical.
+ - Reorder triangle lists for the post transform vertex cache using Tipsify.
+ - Reorder vertices so they are fetched in the order they are first used.
+
+Strips and fans keep their triangle order but are remapped to the welded vertices. Meshes that
+contain out of range indexes are left untouched.
+*/
+void optimizeMesh(tp_math_utils::Geometry3D& mesh, OptimizeStats* stats=nullptr);
+
+//##################################################################################################
+//! Reduce a mesh to targetTriangles or fewer triangles using quadric error edge collapse.
+/*!
+Edges are collapsed onto one of their existing vertices so texture coordinates and normals are kept
+as they are rather than interpolated. Vertices on texture or normal seams and on the boundary of
+the mesh are never moved, so a mesh may not reach the target if it is mostly seams. Collapses that
+would flip a triangle or turn it more than 60 degrees from its original normal are skipped.
+
+The result is a single triangle list that only contains the vertices that are still used. The
+comments and material are not changed. Meshes that are already small enough or that contain out of
+range indexes are left untouched.
+*/
+void simplifyMesh(tp_math_utils::Geometry3D& mesh, size_t targetTriangles);
+
+//##################################################################################################
+//! Call addTriangle for each triangle in the index array, following the winding of strips.
+template<typename AddTriangle>
+void forEachTriangle(const tp_math_utils::Geometry3D& mesh, const tp_math_utils::Indexes3D& index, const AddTriangle& addTriangle)
+{
+  const auto& i = index.indexes;
+  if(index.type == mesh.triangleStrip)
+  {
+    for(size_t n=2; n<i.size(); n++)
+    {
+      if(n&1)
+        addTriangle(i[n-1], i[n-2], i[n]);
+      else
+        addTriangle(i[n-2], i[n-1], i[n]);
+    }
+  }
+  else if(index.type == mesh.triangleFan)
+  {
+    for(size_t n=2; n<i.size(); n++)
+      addTriangle(i[0], i[n-1], i[n]);
+  }
+  else
+  {
+    for(size_t n=2; n<i.size(); n+=3)
+      addTriangle(i[n-2], i[n-1], i[n]);
+  }
+}
+
+//##################################################################################################
+//! Simulate a FIFO post transform cache and return the number of misses for the mesh.
+size_t countCacheMisses(const tp_math_utils::Geometry3D& mesh, size_t cacheSize=vertexCacheSize);
+
+//##################################################################################################
+//! The number of triangles in the mesh including those in strips and fans.
+size_t countTriangles(const tp_math_utils::Geometry3D& mesh);
+
+}
+
+#endif
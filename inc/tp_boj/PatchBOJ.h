@@ -0,0 +1,97 @@
+#ifndef tp_boj_PatchBOJ_h
+#define tp_boj_PatchBOJ_h
+
+#include "tp_boj/ReadBOJ.h"
+
+namespace tp_boj
+{
+
+//##################################################################################################
+//! Options that control how a BOJPatcher updates a file.
+struct PatchOptions
+{
+  //! After a patch the file is compacted if replaced chunks make up more than this fraction of it,
+  //! 1 or more leaves compaction to the caller.
+  float maxUnusedRatio{0.5f};
+};
+
+//##################################################################################################
+//! Replace the materials and comments of a version 29+ .boj file without rewriting its geometry.
+/*!
+Version 29+ files keep the material index and comments of each mesh, and each material, in their
+own chunks that are found through fixed size tables. A patch appends a new chunk to the end of the
+file and then overwrites the table entry that points to it, the geometry and every other chunk are
+left where they are. The new chunk is synced to the disk before the table entry is written, and
+each entry's offset and size are written together in a single 16 byte write, so a patch that is
+interrupted normally leaves either the old or the new chunk in use plus some unused bytes at the
+end. The patcher can't stop the operating system or the disk from tearing that one write.
+
+Replaced chunks stay in the file until it is compacted. Compacting writes a new copy of the file
+that only contains the chunks that are still used, syncs it, and then renames it over the original,
+the geometry is copied as it is without being decoded.
+
+A patcher is not thread safe, and the file should not be read while it is being patched.
+*/
+class TP_BOJ_EXPORT BOJPatcher
+{
+  TP_NONCOPYABLE(BOJPatcher);
+public:
+  //################################################################################################
+  BOJPatcher(const std::string& filePath, const PatchOptions& options=PatchOptions());
+
+  //################################################################################################
+  ~BOJPatcher();
+
+  //################################################################################################
+  //! Returns true if the file was opened, otherwise see error.
+  bool isValid() const;
+
+  //################################################################################################
+  //! The reason that the file could not be opened or that the last patch failed.
+  const ReadError& error() const;
+
+  //################################################################################################
+  size_t meshCount() const;
+
+  //################################################################################################
+  size_t materialCount() const;
+
+  //################################################################################################
+  size_t fileSize() const;
+
+  //################################################################################################
+  //! Bytes of chunks that have been replaced, these are removed by compact.
+  /*!
+  Materials that are no longer used by any mesh are not counted but they are also removed.
+  */
+  size_t unusedBytes() const;
+
+  //################################################################################################
+  //! Replace the comments of a mesh.
+  bool setMeshComments(size_t meshIndex, const std::vector<std::string>& comments);
+
+  //################################################################################################
+  //! Replace the material of a single mesh.
+  /*!
+  If an identical material is already in the file the mesh is pointed at that, otherwise the
+  material is appended to the material table.
+  */
+  bool setMeshMaterial(size_t meshIndex, const tp_math_utils::Material& material);
+
+  //################################################################################################
+  //! Replace a material in the material table, this changes every mesh that uses it.
+  bool setMaterial(size_t materialIndex, const tp_math_utils::Material& material);
+
+  //################################################################################################
+  //! Rewrite the file without the chunks that have been replaced.
+  bool compact();
+
+private:
+  struct Private;
+  friend struct Private;
+  Private* d;
+};
+
+}
+
+#endif
@@ -7,17 +7,211 @@
 
 #include <iosfwd>
 #include <unordered_map>
+#include <functional>
+#include <limits>
 
 namespace tp_boj
 {
 
+//##################################################################################################
+//! Counts and timings collected while reading, these accumulate when passed to multiple calls.
+/*!
+Times are wall time in seconds. When meshes are decoded on multiple threads the vertex, index, and
+material times are summed across threads so they can add up to more than totalSeconds.
+*/
+struct ReadStats
+{
+  uint32_t version{0};    //!< The version of the last file read.
+  size_t bytes{0};        //!< Size of the data passed to deserializeObject.
+  size_t meshes{0};       //!< Meshes loaded, excluding meshes rejected by the filters.
+  size_t verts{0};
+  size_t indexes{0};
+  size_t materials{0};    //!< Materials parsed, version 24+ files parse each distinct material once.
+
+  double fileSeconds{0.0};      //!< Opening and mapping the file.
+  double headerSeconds{0.0};    //!< Version, mesh table, and version 24+ the material table.
+  double validateSeconds{0.0};  //!< Checking the structure of the data before decoding.
+  double vertsSeconds{0.0};     //!< Decompressing and decoding vertices.
+  double indexesSeconds{0.0};   //!< Decompressing and decoding indexes.
+  double materialsSeconds{0.0}; //!< Parsing material state.
+  double texturesSeconds{0.0};  //!< Collecting texture IDs in readObjectAndTexturesFromFile.
+  double totalSeconds{0.0};     //!< Including time spent in the meshDecoded callback.
+};
+
+//##################################################################################################
+//! Describes why data could not be read, see ReadOptions::error.
+struct ReadError
+{
+  static constexpr size_t noMesh = std::numeric_limits<size_t>::max();
+
+  size_t offset{0};         //!< Offset in the data where the problem was found.
+  size_t meshIndex{noMesh}; //!< Index of the mesh in the file, or noMesh for the header.
+  std::string reason;       //!< Empty if there was no error.
+};
+
+//##################################################################################################
+//! Options that control how .boj data is read.
+struct ReadOptions
+{
+  //! The number of threads used to decode version 21+ files, 0 will use one per core.
+  size_t maxThreads{1};
+
+  //! If false vertices and indexes are skipped, the meshes will only contain comments and materials.
+  bool loadGeometry{true};
+
+  //! The level of detail to load from version 27+ files, 0 is the full resolution mesh and each
+  //! level after that is coarser. Meshes with fewer levels load their coarsest.
+  size_t lod{0};
+
+  //! If set only meshes that this returns true for are loaded, called with the index of the mesh in
+  //! the file. In version 21+ files rejected meshes are not read at all.
+  std::function<bool(size_t)> meshIndexFilter;
+
+  //! If set only meshes with a material name that this returns true for are loaded.
+  std::function<bool(const tp_utils::StringID&)> materialFilter;
+
+  //! Note: When maxThreads is not 1 the filters may be called concurrently from multiple threads.
+
+  //! If set this will be filled with counts and timings, the cost is negligible when it is null.
+  ReadStats* stats{nullptr};
+
+  //! If set this is cleared and then filled in if the data can't be read. Exceptions thrown by the
+  //! filters, meshDecoded callbacks, and RenderReadOptions allocators are not reported here, they
+  //! propagate to the caller unchanged.
+  ReadError* error{nullptr};
+};
+
+//##################################################################################################
+//! How vertices are written by deserializeRenderMeshes.
+enum class RenderVertexLayout
+{
+  Interleaved, //!< 8 floats per vertex: position xyz, texture uv, normal xyz.
+  SoA          //!< Separate position xyz, texture uv, and normal xyz arrays.
+};
+
+//##################################################################################################
+//! Where deserializeRenderMeshes writes vertices, only the pointers for the layout are used.
+struct RenderVertexBuffers
+{
+  float* interleaved{nullptr}; //!< 8*vertexCount floats.
+  float* positions{nullptr};   //!< 3*vertexCount floats.
+  float* textures{nullptr};    //!< 2*vertexCount floats.
+  float* normals{nullptr};     //!< 3*vertexCount floats.
+};
+
+//##################################################################################################
+//! A mesh decoded into buffers that can be uploaded for rendering without further processing.
+struct RenderMesh
+{
+  size_t meshIndex{0};  //!< Index of the mesh in the file.
+  std::vector<std::string> comments;
+  tp_math_utils::Material material;
+
+  size_t vertexCount{0};
+  size_t indexCount{0}; //!< Triangle list indexes, strips and fans are flattened to triangles.
+  size_t indexSize{4};  //!< 2 for uint16_t indexes or 4 for uint32_t indexes.
+
+  //! Vertex data if the library allocated it, see RenderReadOptions::allocateVertices.
+  std::vector<float> interleaved;
+  std::vector<float> positions;
+  std::vector<float> textures;
+  std::vector<float> normals;
+
+  //! Index data if the library allocated it, see RenderReadOptions::allocateIndexes.
+  std::vector<uint32_t> indexes32;
+  std::vector<uint16_t> indexes16;
+};
+
+//##################################################################################################
+//! Options that control how render ready meshes are produced.
+struct RenderReadOptions
+{
+  RenderVertexLayout vertexLayout{RenderVertexLayout::Interleaved};
+
+  //! If true meshes with no more than 65536 vertices will have 16 bit indexes.
+  bool allow16BitIndexes{false};
+
+  //! If set this is called to get the memory to write vertices to, for example a mapped GPU buffer.
+  /*!
+  Called with meshIndex, comments, and vertexCount set, the material is not set yet.
+  */
+  std::function<RenderVertexBuffers(const RenderMesh&)> allocateVertices;
+
+  //! If set this is called to get the memory to write indexes to, indexCount*indexSize bytes.
+  /*!
+  Called with everything except the material set.
+  */
+  std::function<void*(const RenderMesh&)> allocateIndexes;
+
+  //! Note: When ReadOptions::maxThreads is not 1 these may be called concurrently.
+};
+
 //##################################################################################################
 std::vector<tp_math_utils::Geometry3D> readObjectAndTexturesFromFile(const std::string& filePath,
                                                                      std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
                                                                      const tp_math_utils::ExtractTextureIDs& extractTextureIDs);
 
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> readObjectAndTexturesFromFile(const std::string& filePath,
+                                                                     std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                                                     const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                                                     const ReadOptions& options);
+
+//##################################################################################################
+//! Streaming version of readObjectAndTexturesFromFile, see the streaming deserializeObject.
+bool readObjectAndTexturesFromFile(const std::string& filePath,
+                                   std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const ReadOptions& options,
+                                   const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded);
+
 //##################################################################################################
 std::vector<tp_math_utils::Geometry3D> deserializeObject(const std::string& data);
+
+//##################################################################################################
+//! Deserialize from a caller owned buffer, for example a MappedFile, without copying it.
+std::vector<tp_math_utils::Geometry3D> deserializeObject(const char* data, size_t size);
+
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> deserializeObject(const char* data, size_t size, const ReadOptions& options);
+
+//##################################################################################################
+//! Deserialize one mesh at a time, passing each to meshDecoded as soon as it has been read.
+/*!
+meshDecoded may take ownership of the mesh by moving out of it, return false from meshDecoded to
+stop reading early. Only a single mesh is held in memory by the reader at any one time.
+
+\returns false if the data is invalid or the version is not supported, meshes decoded before the
+error will already have been passed to meshDecoded.
+*/
+bool deserializeObject(const char* data, size_t size, const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded);
+
+//##################################################################################################
+//! Streaming deserialize with options, meshes rejected by the filters are not passed to meshDecoded.
+bool deserializeObject(const char* data, size_t size, const ReadOptions& options, const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded);
+
+//##################################################################################################
+//! Deserialize the coarsest level of detail of every mesh first and then refine it.
+/*!
+meshDecoded is called with the index of the mesh in the file, the level of detail, and the mesh.
+Every mesh is first passed at its coarsest level, then each level is refined in turn down to
+options.lod and meshes are passed again when they have that level. Files before version 27 only
+have a single level so this is the same as the streaming deserializeObject.
+
+\returns false if the data is invalid or the version is not supported.
+*/
+bool deserializeObjectProgressive(const char* data,
+                                  size_t size,
+                                  const ReadOptions& options,
+                                  const std::function<bool(size_t meshIndex, size_t lod, tp_math_utils::Geometry3D&)>& meshDecoded);
+
+//##################################################################################################
+//! Deserialize straight into render ready buffers without going through Geometry3D.
+std::vector<RenderMesh> deserializeRenderMeshes(const char* data, size_t size, const ReadOptions& options, const RenderReadOptions& renderOptions);
+
+//##################################################################################################
+//! Streaming version of deserializeRenderMeshes, see the streaming deserializeObject.
+bool deserializeRenderMeshes(const char* data, size_t size, const ReadOptions& options, const RenderReadOptions& renderOptions, const std::function<bool(RenderMesh&)>& meshDecoded);
 }
 
 #endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tp_boj/Globals.h" // IWYU pragma: keep
+#include "tp_boj/OptimizeMesh.h"
 #include "tp_math_utils/Geometry3D.h"
 
 #include <iosfwd>
@@ -8,6 +9,89 @@
 namespace tp_boj
 {
 
+//##################################################################################################
+//! Counts and timings collected while writing, these accumulate when passed to multiple calls.
+/*!
+Times are wall time in seconds, phases that run on multiple threads are timed as a whole.
+*/
+struct WriteStats
+{
+  size_t bytes{0};        //!< Size of the serialized object.
+  size_t meshes{0};
+  size_t verts{0};
+  size_t indexes{0};
+  size_t materials{0};    //!< Distinct materials written to the material table.
+  size_t textures{0};     //!< Textures saved by saveTexture, ones that threw are not counted.
+  size_t files{0};        //!< External files saved by saveExternalFile, ones that threw are not counted.
+  size_t lods{0};         //!< Coarser LODs written, not counting the meshes themselves.
+
+  double optimizeSeconds{0.0};  //!< Optimizing meshes and LODs, summed across threads.
+  double encodeSeconds{0.0};    //!< Material state, optimizing, LODs, index encoding, compression, and sizing.
+  double materialsSeconds{0.0}; //!< Building the deduplicated material table.
+  double writeSeconds{0.0};     //!< Writing to the result, or the sink including compression.
+  double resourcesSeconds{0.0}; //!< Saving resources, excluding time overlapped with the geometry.
+  double totalSeconds{0.0};
+};
+
+//##################################################################################################
+//! Options that control how .boj data is written.
+struct WriteOptions
+{
+  //! The number of threads used to encode meshes, 0 will use one per core. The output does not
+  //! depend on the number of threads.
+  size_t maxThreads{1};
+
+  //! Compress vertex and index chunks, chunks that do not get smaller are stored raw.
+  bool compress{false};
+
+  //! Store indexes as zig-zag varint deltas when that is smaller than the narrowest fixed width,
+  //! this suits strips and fans where neighbouring indexes are close together.
+  bool deltaIndexes{false};
+
+  //! Weld vertices and reorder triangles and vertices for the vertex cache before writing, see
+  //! optimizeMesh. Supplied and generated LODs are optimized too. The meshes passed in are not
+  //! modified, each is copied and optimized as it is encoded.
+  bool optimizeMeshes{false};
+
+  //! If set and optimizeMeshes is true this will be filled with before and after stats.
+  OptimizeStats* optimizeStats{nullptr};
+
+  //! Coarser levels of detail for each mesh, lods->at(m) are progressively coarser versions of mesh m.
+  //! Only the vertices and indexes of each LOD are written, the comments and material are shared
+  //! with the mesh. Meshes without supplied LODs use generated ones if generateLODs is set.
+  const std::vector<std::vector<tp_math_utils::Geometry3D>>* lods{nullptr};
+
+  //! The number of coarser LODs to generate with simplifyMesh for meshes without supplied LODs.
+  //! Fewer are written if a mesh can't be simplified any further.
+  size_t generateLODs{0};
+
+  //! Each generated LOD targets this fraction of the triangles of the previous one.
+  float lodRatio{0.5f};
+
+  //! The size of the blocks passed to the sink by the streaming serializeObject. That writer holds
+  //! about one block per thread of encoded meshes at a time, see serializeObject.
+  size_t blockSize{1<<20};
+
+  //! Write files with the streaming serializeObject so that memory use does not grow with the size
+  //! of the file. This encodes every mesh twice so it is slower, by default the file is built in
+  //! memory and written in one go.
+  bool boundedMemory{false};
+
+  //! Save textures and external files on a pool of threads as they are discovered, concurrently
+  //! with each other and with writing the geometry. The callbacks must be thread safe, exceptions
+  //! they throw are collected and reported once the save completes rather than aborting it.
+  bool concurrentResources{false};
+
+  //! The number of threads used to save resources, 0 will use one per core.
+  size_t maxResourceThreads{4};
+
+  //! If set errors from saving resources concurrently are appended to this.
+  std::vector<std::string>* resourceErrors{nullptr};
+
+  //! If set this will be filled with counts and timings, the cost is negligible when it is null.
+  WriteStats* stats{nullptr};
+};
+
 //##################################################################################################
 void writeObjectAndResourcesToFile(const std::vector<tp_math_utils::Geometry3D>& object,
                                    const std::string& filePath,
@@ -15,6 +99,14 @@ void writeObjectAndResourcesToFile(const std::vector<tp_math_utils::Geometry3D>&
                                    const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
                                    const tp_math_utils::ExtractTextureIDs& extractTextureIDs);
 
+//##################################################################################################
+void writeObjectAndResourcesToFile(const std::vector<tp_math_utils::Geometry3D>& object,
+                                   const std::string& filePath,
+                                   const std::function<void(const tp_utils::StringID&, const std::string&)>& saveTexture,
+                                   const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const WriteOptions& options);
+
 //##################################################################################################
 void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>& object,
                                    const std::string& filePath,
@@ -23,10 +115,48 @@ void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>&
                                    const std::function<void(const std::string& path, const std::string& data, bool binary)>& saveFile,
                                    const tp_math_utils::ExtractTextureIDs& extractTextureIDs);
 
+//##################################################################################################
+void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>& object,
+                                   const std::string& filePath,
+                                   const std::function<void(const tp_utils::StringID&, const std::string&)>& saveTexture,
+                                   const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
+                                   const std::function<void(const std::string& path, const std::string& data, bool binary)>& saveFile,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const WriteOptions& options);
+
 //##################################################################################################
 std::string serializeObject(const std::vector<tp_math_utils::Geometry3D>& object,
                             const std::function<void(const tp_utils::StringID&)>& saveTexture,
                             const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
                             const tp_math_utils::ExtractTextureIDs& extractTextureIDs);
 
+//##################################################################################################
+std::string serializeObject(const std::vector<tp_math_utils::Geometry3D>& object,
+                            const std::function<void(const tp_utils::StringID&)>& saveTexture,
+                            const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
+                            const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                            const WriteOptions& options);
+
+//##################################################################################################
+//! Serialize the object to a sink in blocks of at most options.blockSize bytes.
+/*!
+The bytes passed to the sink are identical to the string the other overloads return, but memory use
+does not grow with the size of the file. Beyond the object itself this holds a few sizes and the
+bounds of each mesh, the material table, and a window of encoded meshes of about blockSize bytes per
+thread, or a single mesh if that is larger. Each mesh in the window is held along with its optimized
+copy, its LODs, and its compressed chunks.
+
+To do this every mesh is encoded twice, once to size it for the header and again as it is written,
+so optimizing, generating LODs, and compressing cost twice as much as with the other overloads.
+
+\param sink Called with each block, return false to abort.
+\return true if the sink accepted every block.
+*/
+bool serializeObject(const std::vector<tp_math_utils::Geometry3D>& object,
+                     const std::function<bool(const char* data, size_t size)>& sink,
+                     const std::function<void(const tp_utils::StringID&)>& saveTexture,
+                     const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
+                     const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                     const WriteOptions& options);
+
 }
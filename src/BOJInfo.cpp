@@ -0,0 +1,273 @@
+#include "tp_boj/BOJInfo.h"
+#include "tp_boj/MappedFile.h"
+#include "tp_boj/OptimizeMesh.h"
+
+#include "WriteBOJPrivate.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+namespace tp_boj
+{
+
+namespace
+{
+//##################################################################################################
+//! Versions 26+ store bounds in the header, the layout of the bounds section is the same in each.
+constexpr uint32_t firstBoundsVersion=26;
+
+//##################################################################################################
+bool hasHeaderBounds(uint32_t version)
+{
+  return version>=firstBoundsVersion && version<=maxVersion;
+}
+
+//##################################################################################################
+//! Versions 26 and 27 have the version, object count, and the size of the bounds section.
+constexpr size_t boundsHeaderSize = 16;
+
+//##################################################################################################
+//! The offset of the bounds section or 0 if the header does not fit in size.
+size_t boundsOffset(uint32_t version, const char* data, size_t size)
+{
+  if(version<28)
+    return (size<boundsHeaderSize)?0:boundsHeaderSize;
+
+  if(size<fixedHeaderSize)
+    return 0;
+
+  uint64_t offset;
+  memcpy(&offset, data+16, 8);
+  return (offset<fixedHeaderSize || offset>size)?0:size_t(offset);
+}
+
+//##################################################################################################
+void setError(ReadError* error, size_t offset, const std::string& reason)
+{
+  if(error)
+  {
+    error->offset = offset;
+    error->meshIndex = ReadError::noMesh;
+    error->reason = reason;
+  }
+}
+
+//##################################################################################################
+Bounds readBounds(const char* p)
+{
+  float f[10];
+  uint64_t n[2];
+  memcpy(f, p, sizeof(f));
+  memcpy(n, p+sizeof(f), sizeof(n));
+
+  Bounds bounds;
+  bounds.min       = {f[0], f[1], f[2]};
+  bounds.max       = {f[3], f[4], f[5]};
+  bounds.center    = {f[6], f[7], f[8]};
+  bounds.radius    = f[9];
+  bounds.verts     = size_t(n[0]);
+  bounds.triangles = size_t(n[1]);
+  return bounds;
+}
+
+//##################################################################################################
+//! Returns the version of the data, 0 for unversioned or unknown data.
+uint32_t dataVersion(const char* data, size_t size)
+{
+  if(size<4)
+    return 0;
+
+  uint32_t n;
+  memcpy(&n, data, 4);
+  uint32_t version = uint32_t(0)-n;
+  return (version<10000)?version:0;
+}
+
+//##################################################################################################
+//! Read the bounds section of a version 26+ file, only the start of the file is needed.
+bool readHeaderBounds(const char* data, size_t size, BOJInfo& info, ReadError* error)
+{
+  size_t offset = boundsOffset(info.version, data, size);
+  if(offset==0)
+  {
+    setError(error, 0, "BOJ bounds header buffer overflow.");
+    return false;
+  }
+
+  uint32_t objCount;
+  uint64_t sectionSize;
+  memcpy(&objCount, data+4, 4);
+  memcpy(&sectionSize, data+8, 8);
+
+  if(sectionSize/boundsSize < uint64_t(objCount)+1 || sectionSize > uint64_t(size-offset))
+  {
+    setError(error, 8, "BOJ bounds section out of range.");
+    return false;
+  }
+
+  const char* p = data+offset;
+  info.meshCount = objCount;
+  info.fromHeader = true;
+  info.total = readBounds(p);
+  info.meshes.resize(objCount);
+  for(auto& bounds : info.meshes)
+  {
+    p+=boundsSize;
+    bounds = readBounds(p);
+  }
+
+  return true;
+}
+
+//##################################################################################################
+//! Older files don't store bounds so decode them one mesh at a time and calculate them.
+bool calculateFileBounds(const char* data, size_t size, BOJInfo& info, ReadError* error)
+{
+  ReadOptions options;
+  options.error = error;
+
+  info.meshes.clear();
+  bool ok = deserializeObject(data, size, options, [&](tp_math_utils::Geometry3D& mesh)
+  {
+    info.meshes.push_back(calculateBounds(mesh));
+    return true;
+  });
+
+  if(!ok)
+    return false;
+
+  info.meshCount = info.meshes.size();
+  info.fromHeader = false;
+  info.total = combineBounds(info.meshes);
+  return true;
+}
+}
+
+//##################################################################################################
+Bounds calculateBounds(const tp_math_utils::Geometry3D& mesh)
+{
+  Bounds bounds;
+  bounds.verts = mesh.verts.size();
+  bounds.triangles = countTriangles(mesh);
+
+  if(mesh.verts.empty())
+    return bounds;
+
+  bounds.min = mesh.verts.front().vert;
+  bounds.max = bounds.min;
+  for(const auto& vert : mesh.verts)
+  {
+    bounds.min = glm::min(bounds.min, vert.vert);
+    bounds.max = glm::max(bounds.max, vert.vert);
+  }
+
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+
+  float radiusSquared=0.0f;
+  for(const auto& vert : mesh.verts)
+  {
+    glm::vec3 d = vert.vert - bounds.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+  }
+  bounds.radius = std::sqrt(radiusSquared);
+
+  return bounds;
+}
+
+//##################################################################################################
+Bounds combineBounds(const std::vector<Bounds>& meshes)
+{
+  Bounds total;
+  bool first=true;
+  for(const auto& bounds : meshes)
+  {
+    total.verts += bounds.verts;
+    total.triangles += bounds.triangles;
+
+    if(bounds.verts==0)
+      continue;
+
+    total.min = first?bounds.min:glm::min(total.min, bounds.min);
+    total.max = first?bounds.max:glm::max(total.max, bounds.max);
+    first=false;
+  }
+
+  if(first)
+    return total;
+
+  total.center = (total.min + total.max) * 0.5f;
+  for(const auto& bounds : meshes)
+    if(bounds.verts!=0)
+      total.radius = std::max(total.radius, glm::distance(total.center, bounds.center) + bounds.radius);
+
+  return total;
+}
+
+//##################################################################################################
+bool readBOJInfo(const std::string& filePath, BOJInfo& info, ReadError* error)
+{
+  info = BOJInfo();
+  if(error)
+    *error = ReadError();
+
+  // Read just the bounds section, the rest of the file is not touched.
+  {
+    std::ifstream in(filePath, std::ios::binary|std::ios::ate);
+    if(!in)
+    {
+      setError(error, 0, "Failed to open file.");
+      return false;
+    }
+
+    uint64_t fileSize = uint64_t(in.tellg());
+    in.seekg(0);
+
+    std::string header(size_t(std::min(fileSize, uint64_t(fixedHeaderSize))), '\0');
+    in.read(header.data(), std::streamsize(header.size()));
+
+    info.version = dataVersion(header.data(), header.size());
+    if(hasHeaderBounds(info.version))
+    {
+      size_t offset = boundsOffset(info.version, header.data(), header.size());
+      if(offset==0)
+        return readHeaderBounds(header.data(), header.size(), info, error);
+
+      // Never read past the end of the file, readHeaderBounds reports sections that don't fit.
+      uint64_t sectionSize;
+      memcpy(&sectionSize, header.data()+8, 8);
+      size_t start = header.size();
+      header.resize(size_t(std::max(uint64_t(start), offset + std::min(sectionSize, fileSize-offset))));
+      in.read(header.data()+start, std::streamsize(header.size()-start));
+      header.resize(start + size_t(in.gcount()));
+
+      return readHeaderBounds(header.data(), header.size(), info, error);
+    }
+  }
+
+  MappedFile file(filePath);
+  if(!file.isValid())
+  {
+    setError(error, 0, "Failed to open file.");
+    return false;
+  }
+
+  return calculateFileBounds(file.data(), file.size(), info, error);
+}
+
+//##################################################################################################
+bool readBOJInfo(const char* data, size_t size, BOJInfo& info, ReadError* error)
+{
+  info = BOJInfo();
+  if(error)
+    *error = ReadError();
+
+  info.version = dataVersion(data, size);
+  if(hasHeaderBounds(info.version))
+    return readHeaderBounds(data, size, info, error);
+
+  return calculateFileBounds(data, size, info, error);
+}
+
+}
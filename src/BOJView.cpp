@@ -0,0 +1,325 @@
+#include "tp_boj/BOJView.h"
+#include "tp_boj/MappedFile.h"
+
+#include "ReadBOJPrivate.h"
+
+#include <exception>
+#include <mutex>
+#include <memory>
+
+namespace tp_boj
+{
+
+//##################################################################################################
+struct BOJView::Private
+{
+  TP_NONCOPYABLE(Private);
+
+  std::unique_ptr<MappedFile> file;
+  const char* data{nullptr};
+  size_t size{0};
+  ReadError error;
+
+  //! Unchecked reader positioned after the header, the structure has been validated.
+  Reader<false> reader{nullptr, 0};
+  std::vector<MeshView> meshes;
+
+  //! Materials are decoded on first use from these offsets.
+  std::vector<size_t> materialOffsets;
+  std::unique_ptr<std::once_flag[]> materialOnce;
+  std::vector<tp_math_utils::Material> materials;
+
+  //################################################################################################
+  Private() = default;
+
+  //################################################################################################
+  void open(const char* data_, size_t size_)
+  {
+    data = data_;
+    size = size_;
+
+    size_t meshIndex = ReadError::noMesh;
+    try
+    {
+      if(reinterpret_cast<uintptr_t>(data)%4)
+      {
+        error.reason = "BOJView data must be aligned to 4 bytes.";
+        return;
+      }
+
+      Reader<true> checked(data, size);
+      checked.materialOffsets = &materialOffsets;
+
+      uint32_t objCount=0;
+      if(!checked.readHeader(objCount))
+      {
+        error.reason = "Unsupported BOJ version.";
+        return;
+      }
+
+      if(checked.version<28)
+      {
+        error.reason = "BOJView requires a version 28+ file.";
+        return;
+      }
+
+      checked.validate(objCount, meshIndex);
+      reader = checked.clone<false>();
+
+      meshes.resize(objCount);
+      for(meshIndex=0; meshIndex<objCount; meshIndex++)
+        viewMesh(reader.meshReader(meshIndex, nullptr), meshes[meshIndex]);
+      meshIndex = ReadError::noMesh;
+
+      materialOnce.reset(new std::once_flag[materialOffsets.size()]);
+      materials.resize(materialOffsets.size());
+      return;
+    }
+    catch(const ReadFailure& e)
+    {
+      error.offset = e.offset;
+      error.reason = e.what();
+    }
+    catch(const std::exception& e)
+    {
+      error.reason = e.what();
+    }
+
+    error.meshIndex = meshIndex;
+    meshes.clear();
+    materialOffsets.clear();
+  }
+
+  //################################################################################################
+  void viewMesh(Reader<false> meshReader, MeshView& mesh)
+  {
+    Reader<false> metadataChunk = (meshReader.version>28)?meshReader.metadataReader():Reader<false>(nullptr, 0);
+    Reader<false>& header = (meshReader.version>28)?metadataChunk:meshReader;
+
+    mesh.materialIndex = size_t(header.readInt());
+
+    mesh.comments.resize(size_t(header.readInt()));
+    for(auto& comment : mesh.comments)
+    {
+      size_t n = size_t(header.readInt());
+      comment = std::string_view(header.p, n);
+      header.p+=n;
+    }
+
+    size_t lodCount = size_t(meshReader.readInt());
+    const char* table = meshReader.p;
+    meshReader.p+=lodCount*8;
+    meshReader.skipPadding();
+
+    mesh.lods.resize(lodCount);
+    for(size_t l=0; l<lodCount; l++)
+    {
+      uint64_t lodSize;
+      memcpy(&lodSize, table+l*8, 8);
+
+      const char* start = meshReader.p;
+      viewGeometry(meshReader, mesh.lods[l]);
+      meshReader.p = start+lodSize;
+    }
+  }
+
+  //################################################################################################
+  //! Point geometry at the vertices and indexes of a level, compressed or delta encoded levels are
+  //! left empty with inPlace false.
+  void viewGeometry(Reader<false>& geometryReader, GeometryView& geometry)
+  {
+    if(geometryReader.readInt()!=0)
+      return;
+
+    geometry.vertCount = geometryReader.readVertCount();
+    geometry.verts = reinterpret_cast<const PackedVertex*>(geometryReader.p);
+    geometryReader.p+=geometry.vertCount*sizeof(PackedVertex);
+
+    if(geometryReader.readInt()!=0)
+    {
+      geometry = GeometryView();
+      return;
+    }
+
+    size_t count = size_t(geometryReader.readInt());
+    if(count!=0)
+    {
+      uint32_t encoding = geometryReader.readInt();
+      size_t width = encoding&0xFF;
+      if((encoding&0x100) || (width!=1 && width!=2 && width!=4))
+      {
+        geometry = GeometryView();
+        return;
+      }
+
+      uint64_t tableSize = geometryReader.readUInt64();
+      uint64_t payloadSize = geometryReader.readUInt64();
+      if(tableSize<count)
+        geometryReader.fail("BOJ readPackedIndexes buffer overflow.");
+
+      // The sizes were checked by validate but the lengths in the table were not.
+      auto table = reinterpret_cast<const uint8_t*>(geometryReader.p);
+      auto lengths = table+count;
+      auto tableMax = table+tableSize;
+      auto payload = tableMax;
+      auto payloadMax = payload+payloadSize;
+
+      geometry.indexArrays.resize(count);
+      for(size_t c=0; c<count; c++)
+      {
+        auto& indexArray = geometry.indexArrays[c];
+        switch(table[c])
+        {
+          case 1:  indexArray.type = IndexArrayType::TriangleFan;   break;
+          case 2:  indexArray.type = IndexArrayType::TriangleStrip; break;
+          default: indexArray.type = IndexArrayType::Triangles;     break;
+        }
+
+        uint64_t indexCount=0;
+        if(!readVarint(lengths, tableMax, indexCount))
+          geometryReader.fail("BOJ readPackedIndexes invalid length.");
+
+        if(indexCount>uint64_t(payloadMax-payload)/width)
+          geometryReader.fail("BOJ readPackedIndexes buffer overflow.");
+
+        indexArray.data = payload;
+        indexArray.count = size_t(indexCount);
+        indexArray.width = width;
+        payload+=indexCount*width;
+      }
+    }
+
+    geometry.inPlace = true;
+  }
+};
+
+//##################################################################################################
+BOJView::BOJView(const std::string& filePath):
+  d(new Private())
+{
+  d->file = std::make_unique<MappedFile>(filePath);
+  if(!d->file->isValid())
+  {
+    d->error.reason = "Failed to open file.";
+    return;
+  }
+
+  d->open(d->file->data(), d->file->size());
+}
+
+//##################################################################################################
+BOJView::BOJView(const char* data, size_t size):
+  d(new Private())
+{
+  d->open(data, size);
+}
+
+//##################################################################################################
+BOJView::~BOJView()
+{
+  delete d;
+}
+
+//##################################################################################################
+bool BOJView::isValid() const
+{
+  return d->error.reason.empty();
+}
+
+//##################################################################################################
+const ReadError& BOJView::error() const
+{
+  return d->error;
+}
+
+//##################################################################################################
+uint32_t BOJView::version() const
+{
+  return d->reader.version;
+}
+
+//##################################################################################################
+size_t BOJView::meshCount() const
+{
+  return d->meshes.size();
+}
+
+//##################################################################################################
+const MeshView& BOJView::mesh(size_t meshIndex) const
+{
+  return d->meshes.at(meshIndex);
+}
+
+//##################################################################################################
+size_t BOJView::materialCount() const
+{
+  return d->materialOffsets.size();
+}
+
+//##################################################################################################
+const tp_math_utils::Material& BOJView::material(size_t materialIndex) const
+{
+  auto& material = d->materials.at(materialIndex);
+  std::call_once(d->materialOnce[materialIndex], [&]
+  {
+    // The structure of each material was checked when the view was opened.
+    Reader<false> reader = d->reader.subReader(d->data, d->size, 0);
+    reader.p = d->data + d->materialOffsets[materialIndex];
+    reader.readMaterial(material);
+  });
+  return material;
+}
+
+//##################################################################################################
+bool BOJView::decode(size_t meshIndex, size_t lod, tp_math_utils::Geometry3D& mesh, ReadError* error) const
+{
+  if(error)
+    *error = ReadError();
+
+  if(meshIndex>=d->meshes.size())
+  {
+    if(error)
+      error->reason = "Mesh index out of range.";
+    return false;
+  }
+
+  try
+  {
+    Reader<false> reader = d->reader.meshReader(meshIndex, nullptr);
+    Reader<false> metadataChunk = (reader.version>28)?reader.metadataReader():Reader<false>(nullptr, 0);
+    Reader<false>& header = (reader.version>28)?metadataChunk:reader;
+
+    size_t materialIndex = size_t(header.readInt());
+
+    mesh.comments.resize(size_t(header.readInt()));
+    for(auto& comment : mesh.comments)
+      comment = header.readString();
+
+    reader.seekLOD(lod);
+    reader.readVerts(mesh);
+    reader.readIndexes(mesh);
+    mesh.material = material(materialIndex);
+    return true;
+  }
+  catch(const ReadFailure& e)
+  {
+    if(error)
+    {
+      error->offset = e.offset;
+      error->meshIndex = meshIndex;
+      error->reason = e.what();
+    }
+  }
+  catch(const std::exception& e)
+  {
+    if(error)
+    {
+      error->meshIndex = meshIndex;
+      error->reason = e.what();
+    }
+  }
+
+  return false;
+}
+
+}
@@ -0,0 +1,272 @@
+#include "tp_boj/BatchReadBOJ.h"
+#include "tp_boj/MappedFile.h"
+
+#include "tp_utils/DebugUtils.h"
+
+#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace tp_boj
+{
+
+//##################################################################################################
+struct BatchReader::Private
+{
+  TP_NONCOPYABLE(Private);
+
+  //################################################################################################
+  struct Job
+  {
+    size_t order{0};
+    BatchReadResult result;
+    std::function<void(BatchReadResult&)> loaded;
+    std::unique_ptr<MappedFile> file;
+  };
+
+  //################################################################################################
+  //! A texture path and the order of the file that it came from.
+  struct TexturePath
+  {
+    size_t order{0};
+    std::string path;
+  };
+
+  const tp_math_utils::ExtractTextureIDs extractTextureIDs;
+  const BatchReadOptions options;
+  const size_t maxThreads;
+  const size_t maxInFlight;
+
+  mutable std::mutex mutex;
+  std::condition_variable waitCondition;
+  std::condition_variable doneCondition;
+  std::deque<Job> pending; //!< Queued but not yet mapped.
+  std::deque<Job> ready;   //!< Mapped and being read ahead of decoding.
+  std::vector<std::thread> threads;
+  std::unordered_map<tp_utils::StringID, TexturePath> texturePaths;
+  size_t nextOrder{0};
+  size_t idle{0};
+  size_t inFlight{0};    //!< Files that are mapped, either ready or being decoded.
+  size_t outstanding{0}; //!< Files that have been queued and not yet passed to loaded.
+  bool finished{false};
+
+  //################################################################################################
+  Private(const tp_math_utils::ExtractTextureIDs& extractTextureIDs_, const BatchReadOptions& options_):
+    extractTextureIDs(extractTextureIDs_),
+    options(options_),
+    maxThreads(options.maxThreads?options.maxThreads:std::max(size_t(1), size_t(std::thread::hardware_concurrency()))),
+    maxInFlight(options.maxInFlight?options.maxInFlight:maxThreads*2)
+  {
+
+  }
+
+  //################################################################################################
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+      // Map files and start reading them ahead of decoding so that disk reads overlap with decoding.
+      if(!pending.empty() && inFlight<maxInFlight)
+      {
+        Job job = std::move(pending.front());
+        pending.pop_front();
+        inFlight++;
+        lock.unlock();
+
+        {
+          ReadStats* stats = options.collectStats?&job.result.stats:nullptr;
+          ScopedTimer timer(stats?&stats->fileSeconds:nullptr);
+          ScopedTimer totalTimer(stats?&stats->totalSeconds:nullptr);
+          job.file = std::make_unique<MappedFile>(job.result.filePath);
+          job.file->willNeed();
+        }
+
+        lock.lock();
+        ready.push_back(std::move(job));
+        waitCondition.notify_one();
+        continue;
+      }
+
+      if(!ready.empty())
+      {
+        Job job = std::move(ready.front());
+        ready.pop_front();
+        lock.unlock();
+
+        decode(job);
+
+        lock.lock();
+        if(--outstanding == 0)
+          doneCondition.notify_all();
+        continue;
+      }
+
+      if(finished)
+        return;
+
+      idle++;
+      waitCondition.wait(lock);
+      idle--;
+    }
+  }
+
+  //################################################################################################
+  void decode(Job& job)
+  {
+    BatchReadResult& result = job.result;
+    ReadStats* stats = options.collectStats?&result.stats:nullptr;
+
+    if(!job.file->isValid())
+      result.error.reason = "Failed to open file.";
+    else
+    {
+      ReadOptions readOptions = options.readOptions;
+      readOptions.stats = stats;
+      readOptions.error = &result.error;
+      result.object = deserializeObject(job.file->data(), job.file->size(), readOptions);
+    }
+
+    // Release the mapping as soon as possible so that another file can be read ahead.
+    job.file.reset();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      inFlight--;
+    }
+    waitCondition.notify_one();
+
+    {
+      ScopedTimer timer(stats?&stats->texturesSeconds:nullptr);
+      ScopedTimer totalTimer(stats?&stats->totalSeconds:nullptr);
+
+      std::string directory = getAssociatedFilePath(result.filePath);
+
+      std::unordered_set<tp_utils::StringID> textures;
+      for(const auto& mesh : result.object)
+        mesh.material.allTextureIDs(textures, extractTextureIDs);
+
+      for(const auto& name : textures)
+        result.texturePaths[name] = directory + name.toString() + ".png";
+
+      // Files queued later take priority, the same as loading them one at a time in order.
+      std::unique_lock<std::mutex> lock(mutex);
+      for(const auto& i : result.texturePaths)
+      {
+        auto& texturePath = texturePaths[i.first];
+        if(texturePath.path.empty() || texturePath.order<job.order)
+          texturePath = {job.order, i.second};
+      }
+    }
+
+    try
+    {
+      job.loaded(result);
+    }
+    catch(const std::exception& e)
+    {
+      tpWarning() << "BatchReader loaded callback failed for: " << result.filePath << " " << e.what();
+    }
+    catch(...)
+    {
+      tpWarning() << "BatchReader loaded callback failed for: " << result.filePath;
+    }
+  }
+};
+
+//##################################################################################################
+BatchReader::BatchReader(const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                         const BatchReadOptions& options):
+  d(new Private(extractTextureIDs, options))
+{
+
+}
+
+//##################################################################################################
+BatchReader::~BatchReader()
+{
+  {
+    std::unique_lock<std::mutex> lock(d->mutex);
+    d->finished = true;
+  }
+  d->waitCondition.notify_all();
+
+  for(auto& thread : d->threads)
+    thread.join();
+
+  delete d;
+}
+
+//##################################################################################################
+std::future<BatchReadResult> BatchReader::load(const std::string& filePath)
+{
+  auto promise = std::make_shared<std::promise<BatchReadResult>>();
+  std::future<BatchReadResult> future = promise->get_future();
+  load(filePath, [promise](BatchReadResult& result)
+  {
+    promise->set_value(std::move(result));
+  });
+  return future;
+}
+
+//##################################################################################################
+void BatchReader::load(const std::string& filePath, const std::function<void(BatchReadResult&)>& loaded)
+{
+  std::unique_lock<std::mutex> lock(d->mutex);
+  auto& job = d->pending.emplace_back();
+  job.order = d->nextOrder++;
+  job.result.filePath = filePath;
+  job.loaded = loaded;
+  d->outstanding++;
+
+  // Threads are only started as files are queued, up to the limit.
+  if(d->idle==0 && d->threads.size()<d->maxThreads)
+    d->threads.emplace_back([this]{d->run();});
+  else
+    d->waitCondition.notify_one();
+}
+
+//##################################################################################################
+void BatchReader::wait()
+{
+  std::unique_lock<std::mutex> lock(d->mutex);
+  d->doneCondition.wait(lock, [&]{return d->outstanding==0;});
+}
+
+//##################################################################################################
+std::unordered_map<tp_utils::StringID, std::string> BatchReader::texturePaths() const
+{
+  std::unique_lock<std::mutex> lock(d->mutex);
+  std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+  for(const auto& i : d->texturePaths)
+    texturePaths[i.first] = i.second.path;
+  return texturePaths;
+}
+
+//##################################################################################################
+std::vector<std::vector<tp_math_utils::Geometry3D>> readObjectsAndTexturesFromFiles(const std::vector<std::string>& filePaths,
+                                                                                  std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                                                                  const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                                                                  const BatchReadOptions& options)
+{
+  std::vector<std::vector<tp_math_utils::Geometry3D>> objects(filePaths.size());
+
+  BatchReader reader(extractTextureIDs, options);
+  for(size_t i=0; i<filePaths.size(); i++)
+  {
+    reader.load(filePaths.at(i), [&objects, i](BatchReadResult& result)
+    {
+      objects.at(i) = std::move(result.object);
+    });
+  }
+  reader.wait();
+
+  for(const auto& i : reader.texturePaths())
+    texturePaths[i.first] = i.second;
+
+  return objects;
+}
+
+}
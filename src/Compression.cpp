@@ -0,0 +1,295 @@
+#include "tp_boj/Compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+namespace tp_boj
+{
+
+namespace
+{
+//##################################################################################################
+constexpr size_t minMatch = 4;
+constexpr size_t maxOffset = 65535;
+constexpr int hashBits = 16;
+
+//##################################################################################################
+void shuffle(const char* src, char* dst, size_t size)
+{
+  size_t words = size/4;
+  for(size_t i=0; i<words; i++)
+  {
+    dst[i        ] = src[i*4  ];
+    dst[i+words  ] = src[i*4+1];
+    dst[i+words*2] = src[i*4+2];
+    dst[i+words*3] = src[i*4+3];
+  }
+  memcpy(dst+words*4, src+words*4, size-words*4);
+}
+
+//##################################################################################################
+//! A position in the shuffled stream, plane 4 is the tail that is not a whole word.
+struct Position
+{
+  size_t plane;
+  size_t index;
+};
+
+//##################################################################################################
+//! Writes the shuffled stream straight to its unshuffled position in the output.
+/*!
+The decoder produces the shuffled stream one run at a time, a run never crosses a plane so it can
+be written to the output with a fixed stride. Matches read back through the same mapping, which
+means that the shuffled stream never needs to be held in memory.
+*/
+struct UnshuffledOutput
+{
+  uint8_t* output;
+  size_t words;
+  size_t tail;
+
+  //################################################################################################
+  Position start() const
+  {
+    return {size_t(words?0:4), 0};
+  }
+
+  //################################################################################################
+  uint8_t* at(const Position& position) const
+  {
+    return (position.plane<4)?(output + position.index*4 + position.plane):(output + words*4 + position.index);
+  }
+
+  //################################################################################################
+  //! The number of bytes from position to the end of its plane.
+  size_t run(const Position& position) const
+  {
+    return ((position.plane<4)?words:tail) - position.index;
+  }
+
+  //################################################################################################
+  void advance(Position& position, size_t n) const
+  {
+    position.index+=n;
+    if(position.plane<4 && position.index==words)
+    {
+      position.plane++;
+      position.index=0;
+    }
+  }
+
+  //################################################################################################
+  //! Step back offset bytes, the caller makes sure that this stays within the output.
+  Position back(Position position, size_t offset) const
+  {
+    while(offset>position.index)
+    {
+      offset-=position.index;
+      position.plane--;
+      position.index=words;
+    }
+    position.index-=offset;
+    return position;
+  }
+
+  //################################################################################################
+  void copyLiterals(Position& position, const uint8_t* src, size_t n) const
+  {
+    while(n)
+    {
+      size_t m = std::min(n, run(position));
+      uint8_t* d = at(position);
+      if(position.plane<4)
+        for(size_t c=0; c<m; c++)
+          d[c*4] = src[c];
+      else
+        memcpy(d, src, m);
+
+      advance(position, m);
+      src+=m;
+      n-=m;
+    }
+  }
+
+  //################################################################################################
+  //! Copies forward one byte at a time so matches can overlap the bytes they produce.
+  void copyMatch(Position& position, size_t offset, size_t n) const
+  {
+    Position source = back(position, offset);
+    while(n)
+    {
+      size_t m = std::min(n, std::min(run(position), run(source)));
+      uint8_t* d = at(position);
+      const uint8_t* s = at(source);
+      size_t ds = (position.plane<4)?4:1;
+      size_t ss = (source.plane<4)?4:1;
+      if(ds==4 && ss==4)
+        for(size_t c=0; c<m; c++)
+          d[c*4] = s[c*4];
+      else
+        for(size_t c=0; c<m; c++)
+          d[c*ds] = s[c*ss];
+
+      advance(position, m);
+      advance(source, m);
+      n-=m;
+    }
+  }
+};
+
+//##################################################################################################
+void addLength(std::string& result, size_t length)
+{
+  for(; length>=255; length-=255)
+    result.push_back(char(255));
+  result.push_back(char(length));
+}
+
+//##################################################################################################
+//! Each sequence is a token, literal length, literals, offset and match length.
+void addSequence(std::string& result, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+  size_t matchCode = (matchLength>=minMatch)?(matchLength-minMatch):0;
+
+  uint8_t token = uint8_t(((literalLength<15)?literalLength:15)<<4);
+  token |= uint8_t((matchCode<15)?matchCode:15);
+  result.push_back(char(token));
+
+  if(literalLength>=15)
+    addLength(result, literalLength-15);
+
+  result.append(reinterpret_cast<const char*>(literals), literalLength);
+
+  // The last sequence only contains literals.
+  if(matchLength<minMatch)
+    return;
+
+  result.push_back(char(offset&0xFF));
+  result.push_back(char((offset>>8)&0xFF));
+
+  if(matchCode>=15)
+    addLength(result, matchCode-15);
+}
+}
+
+//##################################################################################################
+std::string compressChunk(const char* data, size_t size)
+{
+  std::string shuffled;
+  shuffled.resize(size);
+  shuffle(data, shuffled.data(), size);
+
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(shuffled.data());
+
+  std::string result;
+  result.reserve(size/2 + 16);
+
+  // Candidate positions are verified so stale entries in the table are harmless.
+  std::vector<size_t> table(size_t(1)<<hashBits, 0);
+
+  size_t anchor=0;
+  size_t i=0;
+  while(i+minMatch<=size)
+  {
+    uint32_t sequence;
+    memcpy(&sequence, src+i, 4);
+    uint32_t hash = (sequence*2654435761u) >> (32-hashBits);
+    size_t candidate = table[hash];
+    table[hash] = i;
+
+    uint32_t candidateSequence=0;
+    if(candidate<i && (i-candidate)<=maxOffset)
+      memcpy(&candidateSequence, src+candidate, 4);
+
+    if(candidate<i && (i-candidate)<=maxOffset && candidateSequence==sequence)
+    {
+      size_t matchLength=minMatch;
+      while(i+matchLength<size && src[candidate+matchLength]==src[i+matchLength])
+        matchLength++;
+
+      addSequence(result, src+anchor, i-anchor, i-candidate, matchLength);
+      i+=matchLength;
+      anchor=i;
+    }
+    else
+    {
+      // Step faster through data that is not compressing.
+      i += 1 + ((i-anchor)>>6);
+    }
+  }
+
+  addSequence(result, src+anchor, size-anchor, 0, 0);
+  return result;
+}
+
+//##################################################################################################
+bool decompressChunk(const char* data, size_t size, char* output, size_t outputSize)
+{
+  UnshuffledOutput out{reinterpret_cast<uint8_t*>(output), outputSize/4, outputSize%4};
+  Position position = out.start();
+
+  const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* sMax = s+size;
+
+  // Position in the shuffled stream.
+  size_t d=0;
+
+  auto readLength = [&](size_t& length)
+  {
+    for(;;)
+    {
+      if(s>=sMax)
+        return false;
+
+      uint8_t b = *(s++);
+      length+=b;
+      if(b!=255)
+        return true;
+    }
+  };
+
+  for(;;)
+  {
+    if(s>=sMax)
+      return false;
+
+    uint8_t token = *(s++);
+
+    size_t literalLength = token>>4;
+    if(literalLength==15 && !readLength(literalLength))
+      return false;
+
+    if(size_t(sMax-s)<literalLength || (outputSize-d)<literalLength)
+      return false;
+
+    out.copyLiterals(position, s, literalLength);
+    d+=literalLength;
+    s+=literalLength;
+
+    if(s==sMax)
+      break;
+
+    if((sMax-s)<2)
+      return false;
+
+    size_t offset = size_t(s[0]) | (size_t(s[1])<<8);
+    s+=2;
+
+    size_t matchLength = token&15;
+    if(matchLength==15 && !readLength(matchLength))
+      return false;
+    matchLength+=minMatch;
+
+    if(offset==0 || offset>d || (outputSize-d)<matchLength)
+      return false;
+
+    out.copyMatch(position, offset, matchLength);
+    d+=matchLength;
+  }
+
+  return d==outputSize;
+}
+
+}
@@ -1,5 +1,9 @@
 #include "tp_boj/Globals.h"
 
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
 namespace tp_boj
 {
 
@@ -76,4 +80,36 @@ std::string getAssociatedFilePath(const std::string& filePath, const std::string
   return directory + filename;
 }
 
+//##################################################################################################
+void parallelFor(size_t count, size_t maxThreads, const std::function<void(size_t)>& fn)
+{
+  if(maxThreads==0)
+    maxThreads = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+
+  size_t threadCount = std::min(maxThreads, count);
+  if(threadCount<2)
+  {
+    for(size_t i=0; i<count; i++)
+      fn(i);
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&]()
+  {
+    for(size_t i=next++; i<count; i=next++)
+      fn(i);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount-1);
+  for(size_t t=1; t<threadCount; t++)
+    threads.emplace_back(worker);
+
+  worker();
+
+  for(auto& thread : threads)
+    thread.join();
+}
+
 }
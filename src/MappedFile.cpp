@@ -0,0 +1,160 @@
+#include "tp_boj/MappedFile.h"
+
+#include "tp_utils/FileUtils.h"
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#elif defined(__EMSCRIPTEN__)
+// Read the file into memory.
+#else
+#  define TP_BOJ_USE_MMAP
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace tp_boj
+{
+
+//##################################################################################################
+struct MappedFile::Private
+{
+  bool valid{false};
+  const char* data{nullptr};
+  size_t size{0};
+
+#if defined(_WIN32)
+  HANDLE file{INVALID_HANDLE_VALUE};
+  HANDLE mapping{nullptr};
+#elif defined(TP_BOJ_USE_MMAP)
+  void* mapping{nullptr};
+#else
+  std::string buffer;
+#endif
+};
+
+//##################################################################################################
+MappedFile::MappedFile(const std::string& filePath):
+  d(new Private())
+{
+#if defined(_WIN32)
+  d->file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(d->file == INVALID_HANDLE_VALUE)
+    return;
+
+  LARGE_INTEGER fileSize;
+  if(!GetFileSizeEx(d->file, &fileSize))
+    return;
+
+  d->size = size_t(fileSize.QuadPart);
+  if(d->size == 0)
+  {
+    d->valid = true;
+    return;
+  }
+
+  d->mapping = CreateFileMappingA(d->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(!d->mapping)
+    return;
+
+  d->data = static_cast<const char*>(MapViewOfFile(d->mapping, FILE_MAP_READ, 0, 0, 0));
+  d->valid = (d->data != nullptr);
+#elif defined(TP_BOJ_USE_MMAP)
+  int fd = open(filePath.c_str(), O_RDONLY);
+  if(fd<0)
+    return;
+
+  struct stat st;
+  if(fstat(fd, &st) == 0)
+  {
+    d->size = size_t(st.st_size);
+    if(d->size == 0)
+      d->valid = true;
+    else
+    {
+      void* mapping = mmap(nullptr, d->size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(mapping != MAP_FAILED)
+      {
+        // The reader walks the file front to back so let the kernel read ahead aggressively.
+        madvise(mapping, d->size, MADV_SEQUENTIAL);
+        d->mapping = mapping;
+        d->data = static_cast<const char*>(mapping);
+        d->valid = true;
+      }
+    }
+  }
+
+  close(fd);
+#else
+  d->buffer = tp_utils::readBinaryFile(filePath);
+  d->data = d->buffer.data();
+  d->size = d->buffer.size();
+  d->valid = true;
+#endif
+
+  if(!d->valid)
+    d->size = 0;
+}
+
+//##################################################################################################
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+  if(d->data)
+    UnmapViewOfFile(d->data);
+
+  if(d->mapping)
+    CloseHandle(d->mapping);
+
+  if(d->file != INVALID_HANDLE_VALUE)
+    CloseHandle(d->file);
+#elif defined(TP_BOJ_USE_MMAP)
+  if(d->mapping)
+    munmap(d->mapping, d->size);
+#endif
+
+  delete d;
+}
+
+//##################################################################################################
+bool MappedFile::isValid() const
+{
+  return d->valid;
+}
+
+//##################################################################################################
+void MappedFile::willNeed() const
+{
+#if defined(_WIN32)
+#  if _WIN32_WINNT >= 0x0602
+  if(d->data)
+  {
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<char*>(d->data);
+    range.NumberOfBytes = d->size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+  }
+#  endif
+#elif defined(TP_BOJ_USE_MMAP)
+  if(d->mapping)
+    madvise(d->mapping, d->size, MADV_WILLNEED);
+#endif
+}
+
+//##################################################################################################
+const char* MappedFile::data() const
+{
+  return d->data;
+}
+
+//##################################################################################################
+size_t MappedFile::size() const
+{
+  return d->size;
+}
+
+}
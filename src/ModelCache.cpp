@@ -0,0 +1,319 @@
+#include "tp_boj/ModelCache.h"
+
+#include <filesystem>
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_set>
+
+namespace tp_boj
+{
+
+namespace
+{
+//##################################################################################################
+//! Identifies a version of a file on disk.
+struct FileKey
+{
+  std::string path;
+  uintmax_t size{0};
+  std::filesystem::file_time_type modified;
+  bool valid{false};
+};
+
+//##################################################################################################
+FileKey fileKey(const std::string& filePath)
+{
+  FileKey key;
+  std::error_code ec;
+
+  std::filesystem::path path = std::filesystem::canonical(filePath, ec);
+  if(ec)
+  {
+    key.path = filePath;
+    return key;
+  }
+  key.path = path.string();
+
+  key.size = std::filesystem::file_size(path, ec);
+  if(ec)
+    return key;
+
+  key.modified = std::filesystem::last_write_time(path, ec);
+  key.valid = !ec;
+  return key;
+}
+
+//##################################################################################################
+//! A rough size for the extended materials that each material keeps on the heap.
+constexpr size_t extendedMaterialBytes=512;
+
+//##################################################################################################
+//! A structural estimate of the heap used by a material, this is run for every mesh so it must not
+//! serialize the material.
+size_t estimateBytes(const tp_math_utils::Material& material, const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
+{
+  std::unordered_set<tp_utils::StringID> textures;
+  material.allTextureIDs(textures, extractTextureIDs);
+  return extendedMaterialBytes + material.name.toString().size() + textures.size()*sizeof(tp_utils::StringID);
+}
+
+//##################################################################################################
+size_t estimateBytes(const CachedModel& model, const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
+{
+  const auto& object = model.object;
+  size_t bytes = object.capacity() * sizeof(tp_math_utils::Geometry3D);
+  for(const auto& mesh : object)
+  {
+    bytes += mesh.verts.capacity() * sizeof(decltype(mesh.verts)::value_type);
+
+    bytes += mesh.indexes.capacity() * sizeof(decltype(mesh.indexes)::value_type);
+    for(const auto& indexes : mesh.indexes)
+      bytes += indexes.indexes.capacity() * sizeof(int);
+
+    bytes += mesh.comments.capacity() * sizeof(std::string);
+    for(const auto& comment : mesh.comments)
+      bytes += comment.capacity();
+
+    bytes += estimateBytes(mesh.material, extractTextureIDs);
+  }
+
+  // Each node of the map holds the key, the path, and a pointer to the next node.
+  const auto& texturePaths = model.texturePaths;
+  bytes += texturePaths.bucket_count() * sizeof(void*);
+  for(const auto& texturePath : texturePaths)
+    bytes += sizeof(texturePath) + sizeof(void*) + texturePath.second.capacity();
+
+  return bytes;
+}
+}
+
+//##################################################################################################
+struct ModelCache::Private
+{
+  TP_NONCOPYABLE(Private);
+
+  //################################################################################################
+  struct Entry
+  {
+    uint64_t id{0};
+    uintmax_t size{0};
+    std::filesystem::file_time_type modified;
+    std::shared_future<std::shared_ptr<const CachedModel>> model;
+    std::list<std::string>::iterator lru;
+    size_t bytes{0};
+    bool loaded{false}; //!< False while the file is being read, these are never evicted.
+  };
+
+  const tp_math_utils::ExtractTextureIDs extractTextureIDs;
+  const ModelCacheOptions options;
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  std::list<std::string> lru; //!< Most recently used at the front.
+  ModelCacheStats stats;
+  uint64_t nextID{0};
+
+  //################################################################################################
+  Private(const tp_math_utils::ExtractTextureIDs& extractTextureIDs_, const ModelCacheOptions& options_):
+    extractTextureIDs(extractTextureIDs_),
+    options(options_)
+  {
+
+  }
+
+  //################################################################################################
+  std::shared_ptr<const CachedModel> read(const std::string& filePath)
+  {
+    auto model = std::make_shared<CachedModel>();
+
+    ReadOptions readOptions = options.readOptions;
+    readOptions.stats = nullptr;
+    readOptions.error = &model->error;
+
+    try
+    {
+      model->object = readObjectAndTexturesFromFile(filePath, model->texturePaths, extractTextureIDs, readOptions);
+    }
+    catch(const std::exception& e)
+    {
+      model->object.clear();
+      model->error.reason = e.what();
+    }
+    catch(...)
+    {
+      model->object.clear();
+      model->error.reason = "Unknown exception reading file.";
+    }
+
+    model->bytes = estimateBytes(*model, extractTextureIDs);
+    return model;
+  }
+
+  //################################################################################################
+  //! Must be called with the mutex locked.
+  void erase(std::unordered_map<std::string, Entry>::iterator i)
+  {
+    stats.bytes -= i->second.bytes;
+    if(i->second.loaded)
+      stats.models--;
+    lru.erase(i->second.lru);
+    entries.erase(i);
+  }
+
+  //################################################################################################
+  //! Erase the entry for path if it is still the one added by the load with this id.
+  void eraseInFlight(const std::string& path, uint64_t id)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(auto i = entries.find(path); i!=entries.end() && i->second.id==id)
+      erase(i);
+  }
+
+  //################################################################################################
+  //! Must be called with the mutex locked.
+  void evict()
+  {
+    auto l = lru.end();
+    while(stats.bytes>options.maxBytes && l!=lru.begin())
+    {
+      --l;
+      auto i = entries.find(*l);
+      if(i->second.loaded)
+      {
+        l = std::next(l);
+        erase(i);
+        stats.evictions++;
+      }
+    }
+  }
+};
+
+//##################################################################################################
+ModelCache::ModelCache(const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                       const ModelCacheOptions& options):
+  d(new Private(extractTextureIDs, options))
+{
+
+}
+
+//##################################################################################################
+ModelCache::~ModelCache()
+{
+  delete d;
+}
+
+//##################################################################################################
+std::shared_ptr<const CachedModel> ModelCache::load(const std::string& filePath)
+{
+  FileKey key = fileKey(filePath);
+
+  // Files that can't be identified are not cached, the read will report the error.
+  if(!key.valid)
+  {
+    {
+      std::unique_lock<std::mutex> lock(d->mutex);
+      d->stats.misses++;
+    }
+    return d->read(filePath);
+  }
+
+  std::promise<std::shared_ptr<const CachedModel>> promise;
+  uint64_t id=0;
+  {
+    std::unique_lock<std::mutex> lock(d->mutex);
+    auto i = d->entries.find(key.path);
+    if(i!=d->entries.end())
+    {
+      if(i->second.size==key.size && i->second.modified==key.modified)
+      {
+        d->stats.hits++;
+        d->lru.splice(d->lru.begin(), d->lru, i->second.lru);
+        auto model = i->second.model;
+        lock.unlock();
+        return model.get();
+      }
+
+      // The file has changed, anyone already holding the old model keeps it.
+      d->erase(i);
+    }
+
+    d->stats.misses++;
+    id = ++d->nextID;
+    d->lru.push_front(key.path);
+
+    auto& entry = d->entries[key.path];
+    entry.id = id;
+    entry.size = key.size;
+    entry.modified = key.modified;
+    entry.model = promise.get_future().share();
+    entry.lru = d->lru.begin();
+  }
+
+  // Only the read is in flight here, failed loads and exceptions remove the entry so that the next
+  // load reads the file again rather than sharing the failure.
+  std::shared_ptr<const CachedModel> model;
+  try
+  {
+    model = d->read(filePath);
+    promise.set_value(model);
+  }
+  catch(...)
+  {
+    promise.set_exception(std::current_exception());
+    d->eraseInFlight(key.path, id);
+    throw;
+  }
+
+  if(!model->error.reason.empty())
+  {
+    d->eraseInFlight(key.path, id);
+    return model;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(d->mutex);
+    auto i = d->entries.find(key.path);
+
+    // The entry may have been removed or replaced while the file was being read.
+    if(i!=d->entries.end() && i->second.id==id)
+    {
+      i->second.loaded = true;
+      i->second.bytes = model->bytes;
+      d->stats.models++;
+      d->stats.bytes += model->bytes;
+      d->evict();
+    }
+  }
+
+  return model;
+}
+
+//##################################################################################################
+void ModelCache::remove(const std::string& filePath)
+{
+  FileKey key = fileKey(filePath);
+
+  std::unique_lock<std::mutex> lock(d->mutex);
+  if(auto i = d->entries.find(key.path); i!=d->entries.end())
+    d->erase(i);
+}
+
+//##################################################################################################
+void ModelCache::clear()
+{
+  std::unique_lock<std::mutex> lock(d->mutex);
+  d->entries.clear();
+  d->lru.clear();
+  d->stats.models = 0;
+  d->stats.bytes = 0;
+}
+
+//##################################################################################################
+ModelCacheStats ModelCache::stats() const
+{
+  std::unique_lock<std::mutex> lock(d->mutex);
+  return d->stats;
+}
+
+}
@@ -0,0 +1,647 @@
+#include "tp_boj/OptimizeMesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace tp_boj
+{
+
+namespace
+{
+//##################################################################################################
+using VertexKey = std::array<uint32_t, 8>;
+
+//##################################################################################################
+VertexKey vertexKey(const tp_math_utils::Vertex3D& vert)
+{
+  float f[8] =
+  {
+    vert.vert.x, vert.vert.y, vert.vert.z,
+    vert.texture.x, vert.texture.y,
+    vert.normal.x, vert.normal.y, vert.normal.z
+  };
+
+  VertexKey key;
+  memcpy(key.data(), f, sizeof(f));
+  return key;
+}
+
+//##################################################################################################
+//! A key with just the position of the vertex, used to find vertices on attribute seams.
+VertexKey positionKey(const tp_math_utils::Vertex3D& vert)
+{
+  float f[3] = {vert.vert.x, vert.vert.y, vert.vert.z};
+
+  VertexKey key{};
+  memcpy(key.data(), f, sizeof(f));
+  return key;
+}
+
+//##################################################################################################
+struct VertexKeyHash
+{
+  size_t operator()(const VertexKey& key) const
+  {
+    uint64_t h=14695981039346656037ull;
+    for(uint32_t k : key)
+      h = (h^k)*1099511628211ull;
+    return size_t(h);
+  }
+};
+
+//##################################################################################################
+//! Returns a welded vertex for each vertex and reduces verts to the unique vertices.
+std::vector<int> weldVertices(std::vector<tp_math_utils::Vertex3D>& verts)
+{
+  std::vector<int> remap(verts.size());
+  std::unordered_map<VertexKey, int, VertexKeyHash> unique;
+  unique.reserve(verts.size());
+
+  size_t c=0;
+  for(size_t v=0; v<verts.size(); v++)
+  {
+    auto i = unique.emplace(vertexKey(verts[v]), int(c));
+    if(i.second)
+      verts[c++] = verts[v];
+    remap[v] = i.first->second;
+  }
+
+  verts.resize(c);
+  return remap;
+}
+
+//##################################################################################################
+//! Garland and Heckbert error quadric, the upper triangle of a symmetric 4x4 matrix.
+struct Quadric
+{
+  std::array<double, 10> q{};
+
+  //################################################################################################
+  //! Add the plane ax+by+cz+d=0 with weight w, the normal must be unit length.
+  void addPlane(double a, double b, double c, double d, double w)
+  {
+    q[0]+=w*a*a; q[1]+=w*a*b; q[2]+=w*a*c; q[3]+=w*a*d;
+    q[4]+=w*b*b; q[5]+=w*b*c; q[6]+=w*b*d;
+    q[7]+=w*c*c; q[8]+=w*c*d;
+    q[9]+=w*d*d;
+  }
+
+  //################################################################################################
+  Quadric& operator+=(const Quadric& other)
+  {
+    for(size_t n=0; n<q.size(); n++)
+      q[n] += other.q[n];
+    return *this;
+  }
+
+  //################################################################################################
+  //! The weighted sum of squared distances from p to each plane.
+  double error(const glm::vec3& p) const
+  {
+    double x=p.x;
+    double y=p.y;
+    double z=p.z;
+    return q[0]*x*x + 2.0*q[1]*x*y + 2.0*q[2]*x*z + 2.0*q[3]*x
+        +  q[4]*y*y + 2.0*q[5]*y*z + 2.0*q[6]*y
+        +  q[7]*z*z + 2.0*q[8]*z
+        +  q[9];
+  }
+};
+
+//##################################################################################################
+//! The unnormalized normal of a triangle, its length is twice the area.
+std::array<double, 3> triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+  double ux=double(b.x)-a.x, uy=double(b.y)-a.y, uz=double(b.z)-a.z;
+  double vx=double(c.x)-a.x, vy=double(c.y)-a.y, vz=double(c.z)-a.z;
+  return {uy*vz-uz*vy, uz*vx-ux*vz, ux*vy-uy*vx};
+}
+
+//##################################################################################################
+double dot(const std::array<double, 3>& a, const std::array<double, 3>& b)
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+//##################################################################################################
+//! The cosine of the largest change in a triangle's normal that simplifyMesh allows, 60 degrees.
+constexpr double maxNormalRotation = 0.5;
+
+//##################################################################################################
+//! A candidate edge collapse that moves vertex from onto vertex to.
+struct Collapse
+{
+  double cost;
+  uint32_t from;
+  uint32_t to;
+  uint32_t fromStamp; //!< Collapses are dropped if either quadric changed since they were queued.
+  uint32_t toStamp;
+
+  //################################################################################################
+  bool operator>(const Collapse& other) const
+  {
+    return cost>other.cost;
+  }
+};
+
+//##################################################################################################
+//! Tipsify, Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+//! Overdraw" 2007. Reorders a triangle list for a post transform cache of cacheSize entries.
+std::vector<int> tipsify(const std::vector<int>& indexes, size_t vertCount, int cacheSize)
+{
+  size_t triangleCount = indexes.size()/3;
+
+  // Vertex to triangle adjacency.
+  std::vector<uint32_t> liveTriangles(vertCount, 0);
+  for(size_t n=0; n<triangleCount*3; n++)
+    liveTriangles[size_t(indexes[n])]++;
+
+  std::vector<size_t> offsets(vertCount+1, 0);
+  for(size_t v=0; v<vertCount; v++)
+    offsets[v+1] = offsets[v] + liveTriangles[v];
+
+  std::vector<uint32_t> adjacency(triangleCount*3);
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end()-1);
+    for(size_t n=0; n<triangleCount*3; n++)
+      adjacency[fill[size_t(indexes[n])]++] = uint32_t(n/3);
+  }
+
+  std::vector<int> cacheTime(vertCount, 0);
+  std::vector<char> emitted(triangleCount, 0);
+  std::vector<int> deadEnd;
+  std::vector<int> candidates;
+  int timeStamp = cacheSize+1;
+  size_t cursor=0;
+
+  std::vector<int> result;
+  result.reserve(triangleCount*3);
+
+  auto skipDeadEnd = [&]()
+  {
+    while(!deadEnd.empty())
+    {
+      int v = deadEnd.back();
+      deadEnd.pop_back();
+      if(liveTriangles[size_t(v)]>0)
+        return v;
+    }
+
+    for(; cursor<vertCount; cursor++)
+      if(liveTriangles[cursor]>0)
+        return int(cursor);
+
+    return -1;
+  };
+
+  auto getNextVertex = [&]()
+  {
+    int best=-1;
+    int bestPriority=-1;
+    for(int v : candidates)
+    {
+      if(liveTriangles[size_t(v)]==0)
+        continue;
+
+      // Prefer vertices that will still be in the cache once all of their triangles are emitted.
+      int priority=0;
+      if(timeStamp-cacheTime[size_t(v)] + 2*int(liveTriangles[size_t(v)]) <= cacheSize)
+        priority = timeStamp-cacheTime[size_t(v)];
+
+      if(priority>bestPriority)
+      {
+        best = v;
+        bestPriority = priority;
+      }
+    }
+
+    return (best==-1)?skipDeadEnd():best;
+  };
+
+  int fanning = skipDeadEnd();
+  while(fanning>=0)
+  {
+    candidates.clear();
+    for(size_t a=offsets[size_t(fanning)]; a<offsets[size_t(fanning)+1]; a++)
+    {
+      uint32_t t = adjacency[a];
+      if(emitted[t])
+        continue;
+      emitted[t] = 1;
+
+      for(size_t n=0; n<3; n++)
+      {
+        int v = indexes[t*3+n];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[size_t(v)]--;
+
+        if(timeStamp-cacheTime[size_t(v)] > cacheSize)
+          cacheTime[size_t(v)] = timeStamp++;
+      }
+    }
+
+    fanning = getNextVertex();
+  }
+
+  // Keep any trailing indexes that do not form a whole triangle.
+  result.insert(result.end(), indexes.begin()+std::ptrdiff_t(triangleCount*3), indexes.end());
+  return result;
+}
+}
+
+//##################################################################################################
+void optimizeMesh(tp_math_utils::Geometry3D& mesh, OptimizeStats* stats)
+{
+  for(const auto& index : mesh.indexes)
+    for(int i : index.indexes)
+      if(i<0 || size_t(i)>=mesh.verts.size())
+        return;
+
+  size_t vertsBefore = mesh.verts.size();
+  size_t cacheMissesBefore = stats?countCacheMisses(mesh):0;
+
+  // Weld.
+  {
+    std::vector<int> remap = weldVertices(mesh.verts);
+    for(auto& index : mesh.indexes)
+      for(int& i : index.indexes)
+        i = remap[size_t(i)];
+  }
+
+  // Reorder triangles.
+  for(auto& index : mesh.indexes)
+    if(index.type != mesh.triangleStrip && index.type != mesh.triangleFan)
+      index.indexes = tipsify(index.indexes, mesh.verts.size(), int(vertexCacheSize));
+
+  // Reorder vertices in the order that they are first used, unused vertices go at the end.
+  {
+    std::vector<int> remap(mesh.verts.size(), -1);
+    int c=0;
+    for(auto& index : mesh.indexes)
+    {
+      for(int& i : index.indexes)
+      {
+        int& r = remap[size_t(i)];
+        if(r<0)
+          r = c++;
+        i = r;
+      }
+    }
+
+    for(int& r : remap)
+      if(r<0)
+        r = c++;
+
+    std::vector<tp_math_utils::Vertex3D> verts(mesh.verts.size());
+    for(size_t v=0; v<mesh.verts.size(); v++)
+      verts[size_t(remap[v])] = mesh.verts[v];
+    mesh.verts.swap(verts);
+  }
+
+  if(stats)
+  {
+    stats->meshes++;
+    stats->vertsBefore += vertsBefore;
+    stats->vertsAfter += mesh.verts.size();
+    stats->triangles += countTriangles(mesh);
+    stats->cacheMissesBefore += cacheMissesBefore;
+    stats->cacheMissesAfter += countCacheMisses(mesh);
+  }
+}
+
+//##################################################################################################
+void simplifyMesh(tp_math_utils::Geometry3D& mesh, size_t targetTriangles)
+{
+  for(const auto& index : mesh.indexes)
+    for(int i : index.indexes)
+      if(i<0 || size_t(i)>=mesh.verts.size())
+        return;
+
+  std::vector<uint32_t> triangles;
+  for(const auto& index : mesh.indexes)
+  {
+    forEachTriangle(mesh, index, [&](int a, int b, int c)
+    {
+      triangles.push_back(uint32_t(a));
+      triangles.push_back(uint32_t(b));
+      triangles.push_back(uint32_t(c));
+    });
+  }
+
+  size_t triangleCount = triangles.size()/3;
+  if(triangleCount<=targetTriangles)
+    return;
+
+  // Weld so that triangles that only share identical copies of a vertex are connected.
+  {
+    std::vector<int> remap = weldVertices(mesh.verts);
+    for(uint32_t& i : triangles)
+      i = uint32_t(remap[i]);
+  }
+
+  const auto& verts = mesh.verts;
+  size_t vertCount = verts.size();
+
+  std::vector<char> deadTriangle(triangleCount, 0);
+  size_t liveTriangles = triangleCount;
+  for(size_t t=0; t<triangleCount; t++)
+  {
+    const uint32_t* i = triangles.data()+t*3;
+    if(i[0]==i[1] || i[1]==i[2] || i[2]==i[0])
+    {
+      deadTriangle[t] = 1;
+      liveTriangles--;
+    }
+  }
+
+  // Vertices that share a position with another vertex are on a texture or normal seam, and
+  // vertices on boundary or non manifold edges are on the outline, these never move.
+  std::vector<char> locked(vertCount, 0);
+  {
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> positions;
+    positions.reserve(vertCount);
+    for(size_t v=0; v<vertCount; v++)
+    {
+      auto i = positions.emplace(positionKey(verts[v]), uint32_t(v));
+      if(!i.second)
+      {
+        locked[v] = 1;
+        locked[i.first->second] = 1;
+      }
+    }
+  }
+
+  std::vector<uint64_t> edges;
+  edges.reserve(liveTriangles*3);
+  for(size_t t=0; t<triangleCount; t++)
+  {
+    if(deadTriangle[t])
+      continue;
+
+    const uint32_t* i = triangles.data()+t*3;
+    for(size_t n=0; n<3; n++)
+    {
+      uint64_t a = i[n];
+      uint64_t b = i[(n+1)%3];
+      edges.push_back((std::min(a, b)<<32) | std::max(a, b));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  {
+    size_t c=0;
+    for(size_t e=0; e<edges.size();)
+    {
+      size_t end=e+1;
+      while(end<edges.size() && edges[end]==edges[e])
+        end++;
+
+      if(end-e != 2)
+      {
+        locked[size_t(edges[e]>>32)] = 1;
+        locked[size_t(edges[e]&0xFFFFFFFF)] = 1;
+      }
+
+      edges[c++] = edges[e];
+      e = end;
+    }
+    edges.resize(c);
+  }
+
+  // Quadrics, vertex to triangle adjacency, and the unit normal of each triangle.
+  std::vector<Quadric> quadrics(vertCount);
+  std::vector<std::array<double, 3>> normals(triangleCount, std::array<double, 3>{0.0, 0.0, 0.0});
+  std::vector<std::vector<uint32_t>> adjacency(vertCount);
+  {
+    std::vector<uint32_t> counts(vertCount, 0);
+    for(size_t t=0; t<triangleCount; t++)
+      if(!deadTriangle[t])
+        for(size_t n=0; n<3; n++)
+          counts[triangles[t*3+n]]++;
+
+    for(size_t v=0; v<vertCount; v++)
+      adjacency[v].reserve(counts[v]);
+  }
+
+  for(size_t t=0; t<triangleCount; t++)
+  {
+    if(deadTriangle[t])
+      continue;
+
+    const uint32_t* i = triangles.data()+t*3;
+    for(size_t n=0; n<3; n++)
+      adjacency[i[n]].push_back(uint32_t(t));
+
+    const glm::vec3& p = verts[i[0]].vert;
+    std::array<double, 3> normal = triangleNormal(p, verts[i[1]].vert, verts[i[2]].vert);
+    double length = std::sqrt(dot(normal, normal));
+    if(length<=0.0)
+      continue;
+
+    double a=normal[0]/length;
+    double b=normal[1]/length;
+    double c=normal[2]/length;
+    double d = -(a*p.x + b*p.y + c*p.z);
+    normals[t] = {a, b, c};
+
+    Quadric quadric;
+    quadric.addPlane(a, b, c, d, length*0.5);
+    for(size_t n=0; n<3; n++)
+      quadrics[i[n]] += quadric;
+  }
+
+  std::vector<uint32_t> stamps(vertCount, 0);
+  std::vector<char> removed(vertCount, 0);
+
+  // The cheapest direction to collapse an edge in, from is locked if both ends are.
+  auto edgeCollapse = [&](uint32_t a, uint32_t b) -> Collapse
+  {
+    Quadric quadric = quadrics[a];
+    quadric += quadrics[b];
+
+    constexpr double never = std::numeric_limits<double>::max();
+    double costA = locked[a]?never:quadric.error(verts[b].vert);
+    double costB = locked[b]?never:quadric.error(verts[a].vert);
+
+    if(costA<=costB)
+      return {costA, a, b, stamps[a], stamps[b]};
+    return {costB, b, a, stamps[b], stamps[a]};
+  };
+
+  std::vector<Collapse> collapses;
+  collapses.reserve(edges.size());
+  for(uint64_t edge : edges)
+    if(Collapse collapse = edgeCollapse(uint32_t(edge>>32), uint32_t(edge&0xFFFFFFFF)); !locked[collapse.from])
+      collapses.push_back(collapse);
+  edges = std::vector<uint64_t>();
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue(std::greater<Collapse>(), std::move(collapses));
+
+  std::vector<uint32_t> neighbours;
+  while(liveTriangles>targetTriangles && !queue.empty())
+  {
+    Collapse collapse = queue.top();
+    queue.pop();
+
+    uint32_t from = collapse.from;
+    uint32_t to = collapse.to;
+    if(removed[from] || removed[to])
+      continue;
+
+    // Every edge around a vertex is queued again when its quadric changes so stale ones are dropped.
+    if(stamps[from]!=collapse.fromStamp || stamps[to]!=collapse.toStamp)
+      continue;
+
+    // Reject collapses that would flip or fold a triangle, and edges that no longer exist. Triangles
+    // are compared to their original normal so that rotations don't accumulate over collapses.
+    bool shared=false;
+    bool flips=false;
+    for(uint32_t t : adjacency[from])
+    {
+      if(deadTriangle[t])
+        continue;
+
+      const uint32_t* i = triangles.data()+size_t(t)*3;
+      if(i[0]==to || i[1]==to || i[2]==to)
+      {
+        shared = true;
+        continue;
+      }
+
+      std::array<const glm::vec3*, 3> p;
+      for(size_t n=0; n<3; n++)
+        p[n] = &verts[(i[n]==from)?to:i[n]].vert;
+
+      const std::array<double, 3>& before = normals[t];
+      std::array<double, 3> after = triangleNormal(*p[0], *p[1], *p[2]);
+      if(dot(before, before)>0.0 && dot(before, after) <= maxNormalRotation*std::sqrt(dot(after, after)))
+      {
+        flips = true;
+        break;
+      }
+    }
+
+    if(!shared || flips)
+      continue;
+
+    for(uint32_t t : adjacency[from])
+    {
+      if(deadTriangle[t])
+        continue;
+
+      uint32_t* i = triangles.data()+size_t(t)*3;
+      if(i[0]==to || i[1]==to || i[2]==to)
+      {
+        deadTriangle[t] = 1;
+        liveTriangles--;
+        continue;
+      }
+
+      for(size_t n=0; n<3; n++)
+        if(i[n]==from)
+          i[n] = to;
+      adjacency[to].push_back(t);
+    }
+
+    adjacency[from] = std::vector<uint32_t>();
+    removed[from] = 1;
+    quadrics[to] += quadrics[from];
+    stamps[to]++;
+
+    // Queue the edges around the merged vertex, this includes the edges that it gained from.
+    auto& around = adjacency[to];
+    around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t){return deadTriangle[t]!=0;}), around.end());
+
+    neighbours.clear();
+    for(uint32_t t : around)
+    {
+      const uint32_t* i = triangles.data()+size_t(t)*3;
+      for(size_t n=0; n<3; n++)
+        if(i[n]!=to)
+          neighbours.push_back(i[n]);
+    }
+
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    for(uint32_t n : neighbours)
+      if(Collapse next = edgeCollapse(to, n); !locked[next.from])
+        queue.push(next);
+  }
+
+  // Write the remaining triangles as a single list using only the vertices that they reference.
+  std::vector<int> remap(vertCount, -1);
+  std::vector<tp_math_utils::Vertex3D> simplifiedVerts;
+  tp_math_utils::Indexes3D simplifiedIndexes;
+  simplifiedIndexes.type = mesh.triangles;
+  simplifiedIndexes.indexes.reserve(liveTriangles*3);
+  for(size_t t=0; t<triangleCount; t++)
+  {
+    if(deadTriangle[t])
+      continue;
+
+    for(size_t n=0; n<3; n++)
+    {
+      uint32_t v = triangles[t*3+n];
+      int& r = remap[v];
+      if(r<0)
+      {
+        r = int(simplifiedVerts.size());
+        simplifiedVerts.push_back(verts[v]);
+      }
+      simplifiedIndexes.indexes.push_back(r);
+    }
+  }
+
+  mesh.verts.swap(simplifiedVerts);
+  mesh.indexes.clear();
+  mesh.indexes.push_back(std::move(simplifiedIndexes));
+}
+
+//##################################################################################################
+size_t countCacheMisses(const tp_math_utils::Geometry3D& mesh, size_t cacheSize)
+{
+  // FIFO cache, the time each vertex entered the cache.
+  std::unordered_map<int, size_t> entered;
+  size_t time=0;
+  size_t misses=0;
+
+  auto addVertex = [&](int v)
+  {
+    auto i = entered.find(v);
+    if(i != entered.end() && (time-i->second)<cacheSize)
+      return;
+
+    entered[v] = time++;
+    misses++;
+  };
+
+  for(const auto& index : mesh.indexes)
+  {
+    forEachTriangle(mesh, index, [&](int a, int b, int c)
+    {
+      addVertex(a);
+      addVertex(b);
+      addVertex(c);
+    });
+  }
+
+  return misses;
+}
+
+//##################################################################################################
+size_t countTriangles(const tp_math_utils::Geometry3D& mesh)
+{
+  size_t count=0;
+  for(const auto& index : mesh.indexes)
+    forEachTriangle(mesh, index, [&](int, int, int){count++;});
+  return count;
+}
+
+}
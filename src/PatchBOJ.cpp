@@ -0,0 +1,672 @@
+#include "tp_boj/PatchBOJ.h"
+
+#include "WriteBOJPrivate.h"
+
+#include <cstdio>
+#include <limits>
+#include <fstream>
+#include <filesystem>
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#elif defined(__EMSCRIPTEN__)
+// Files live in memory, there is nothing to sync.
+#else
+#  define TP_BOJ_USE_FSYNC
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace tp_boj
+{
+
+//##################################################################################################
+bool syncFile(const std::string& path)
+{
+#if defined(_WIN32)
+  HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(handle==INVALID_HANDLE_VALUE)
+    return false;
+  bool ok = FlushFileBuffers(handle);
+  CloseHandle(handle);
+  return ok;
+#elif defined(TP_BOJ_USE_FSYNC)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd<0)
+    return false;
+  bool ok = ::fsync(fd)==0;
+  ::close(fd);
+  return ok;
+#else
+  TP_UNUSED(path);
+  return true;
+#endif
+}
+
+//##################################################################################################
+void syncParentDirectory(const std::string& path)
+{
+#ifdef TP_BOJ_USE_FSYNC
+  std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  syncFile(parent.empty()?std::string("."):parent.string());
+#else
+  TP_UNUSED(path);
+#endif
+}
+
+//##################################################################################################
+struct BOJPatcher::Private
+{
+  TP_NONCOPYABLE(Private);
+
+  //################################################################################################
+  //! The offset and size of a chunk in the file.
+  struct Chunk
+  {
+    uint64_t offset{0};
+    uint64_t size{0};
+  };
+
+  //################################################################################################
+  struct MeshEntry
+  {
+    Chunk geometry;
+    Chunk metadata;
+  };
+
+  //! Offsets of the fields in the fixed header that are changed by patches.
+  static constexpr uint64_t materialTableOffsetField=32;
+  static constexpr uint64_t materialTableSizeField=40;
+  static constexpr uint64_t unusedBytesField=56;
+
+  const std::string filePath;
+  const PatchOptions options;
+  std::fstream file;
+  ReadError error;
+  bool valid{false};
+
+  uint64_t fileSize{0};
+  uint64_t unusedBytes{0};
+  Chunk bounds;
+  uint64_t meshTableOffset{0};
+  Chunk materialTable;
+
+  std::vector<MeshEntry> meshes;
+  std::vector<Chunk> materials;
+  std::vector<std::string> materialData; //!< The bytes of each material, used to find duplicates.
+
+  //################################################################################################
+  Private(const std::string& filePath_, const PatchOptions& options_):
+    filePath(filePath_),
+    options(options_)
+  {
+
+  }
+
+  //################################################################################################
+  bool fail(uint64_t offset, const std::string& reason, size_t meshIndex=ReadError::noMesh)
+  {
+    error.offset = size_t(offset);
+    error.meshIndex = meshIndex;
+    error.reason = reason;
+    return false;
+  }
+
+  //################################################################################################
+  bool inRange(const Chunk& chunk) const
+  {
+    return chunk.offset<=fileSize && chunk.size<=(fileSize-chunk.offset);
+  }
+
+  //################################################################################################
+  bool read(uint64_t offset, void* data, size_t size)
+  {
+    file.clear();
+    file.seekg(std::streamoff(offset));
+    file.read(static_cast<char*>(data), std::streamsize(size));
+    return file && size_t(file.gcount())==size;
+  }
+
+  //################################################################################################
+  bool readChunk(const Chunk& chunk, std::string& data)
+  {
+    data.resize(size_t(chunk.size));
+    return read(chunk.offset, data.data(), data.size());
+  }
+
+  //################################################################################################
+  bool writeUInt64(uint64_t offset, uint64_t n)
+  {
+    file.clear();
+    file.seekp(std::streamoff(offset));
+    file.write(reinterpret_cast<const char*>(&n), 8);
+    return bool(file);
+  }
+
+  //################################################################################################
+  //! Point a table entry at a chunk, the offset and size are written together.
+  bool writeChunkEntry(uint64_t offset, const Chunk& chunk)
+  {
+    uint64_t entry[2]{chunk.offset, chunk.size};
+    file.clear();
+    file.seekp(std::streamoff(offset));
+    file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+    return bool(file);
+  }
+
+  //################################################################################################
+  //! Flush everything written so far through to the disk.
+  bool sync()
+  {
+    file.flush();
+    if(!file || !syncFile(filePath))
+      return fail(0, "Failed to sync file.");
+    return true;
+  }
+
+  //################################################################################################
+  //! Write data to the end of the file, call sync before any table is pointed at it.
+  bool append(const std::string& data, Chunk& chunk)
+  {
+    file.clear();
+    file.seekp(std::streamoff(fileSize));
+    file.write(data.data(), std::streamsize(data.size()));
+    if(!file)
+      return fail(fileSize, "Failed to write file.");
+
+    chunk.offset = fileSize;
+    chunk.size = data.size();
+    fileSize += data.size();
+    return true;
+  }
+
+  //################################################################################################
+  template<typename Write>
+  static std::string encode(const Write& write)
+  {
+    SizeWriter sizeWriter;
+    write(sizeWriter);
+
+    std::string data(sizeWriter.size, '\0');
+    BufferWriter writer{data.data()};
+    write(writer);
+    return data;
+  }
+
+  //################################################################################################
+  static std::string encodeMaterial(const tp_math_utils::Material& material)
+  {
+    MaterialEntry entry = makeMaterialEntry(material);
+    return encode([&](auto& writer){writeMaterial(writer, entry);});
+  }
+
+  //################################################################################################
+  static std::string encodeMetadata(uint32_t materialIndex, const std::vector<std::string>& comments)
+  {
+    return encode([&](auto& writer){writeMeshMetadata(writer, materialIndex, comments);});
+  }
+
+  //################################################################################################
+  bool open()
+  {
+    valid = false;
+    meshes.clear();
+    materials.clear();
+    materialData.clear();
+
+    file.close();
+    file.clear();
+    file.open(filePath, std::ios::in|std::ios::out|std::ios::binary);
+    if(!file)
+      return fail(0, "Failed to open file.");
+
+    file.seekg(0, std::ios::end);
+    fileSize = uint64_t(file.tellg());
+
+    char header[fixedHeaderSize];
+    if(!read(0, header, fixedHeaderSize))
+      return fail(0, "BOJ header buffer overflow.");
+
+    uint32_t n;
+    memcpy(&n, header, 4);
+    uint32_t version = uint32_t(0)-n;
+    if(version<29 || version>=10000)
+      return fail(0, "BOJPatcher requires a version 29+ file.");
+    if(version>maxVersion)
+      return fail(0, "Unsupported BOJ version.");
+
+    uint32_t objCount;
+    uint32_t alignment;
+    uint32_t entrySize;
+    memcpy(&objCount, header+4, 4);
+    memcpy(&bounds.size, header+8, 8);
+    memcpy(&bounds.offset, header+16, 8);
+    memcpy(&meshTableOffset, header+24, 8);
+    memcpy(&materialTable.offset, header+materialTableOffsetField, 8);
+    memcpy(&materialTable.size, header+materialTableSizeField, 8);
+    memcpy(&alignment, header+48, 4);
+    memcpy(&entrySize, header+52, 4);
+    memcpy(&unusedBytes, header+unusedBytesField, 8);
+
+    if(alignment!=blockAlignment)
+      return fail(48, "BOJ unsupported alignment.");
+    if(entrySize!=meshEntrySize)
+      return fail(52, "BOJ unsupported mesh table entry size.");
+    if(!inRange(bounds))
+      return fail(8, "BOJ bounds section out of range.");
+
+    // The geometry is never read but it is checked so that compaction can't copy past the end.
+    std::vector<uint64_t> table(size_t(objCount)*4);
+    if(!inRange({meshTableOffset, uint64_t(objCount)*meshEntrySize}) || !read(meshTableOffset, table.data(), table.size()*8))
+      return fail(24, "BOJ mesh table out of range.");
+
+    meshes.resize(objCount);
+    for(size_t m=0; m<meshes.size(); m++)
+    {
+      auto& mesh = meshes.at(m);
+      mesh.geometry = {table.at(m*4), table.at(m*4+1)};
+      mesh.metadata = {table.at(m*4+2), table.at(m*4+3)};
+      if(!inRange(mesh.geometry) || !inRange(mesh.metadata))
+        return fail(meshTableOffset+m*meshEntrySize, "BOJ mesh table out of range.", m);
+    }
+
+    uint32_t materialCount=0;
+    if(materialTable.size<materialTableHeaderSize || !inRange(materialTable) || !read(materialTable.offset, &materialCount, 4))
+      return fail(materialTableOffsetField, "BOJ material table out of range.");
+    if((materialTable.size-materialTableHeaderSize)/materialEntrySize < materialCount)
+      return fail(materialTable.offset, "BOJ material table buffer overflow.");
+
+    table.resize(size_t(materialCount)*2);
+    if(!read(materialTable.offset+materialTableHeaderSize, table.data(), table.size()*8))
+      return fail(materialTable.offset, "BOJ material table buffer overflow.");
+
+    materials.resize(materialCount);
+    materialData.resize(materialCount);
+    for(size_t i=0; i<materials.size(); i++)
+    {
+      materials.at(i) = {table.at(i*2), table.at(i*2+1)};
+      if(!inRange(materials.at(i)) || !readChunk(materials.at(i), materialData.at(i)))
+        return fail(materialTable.offset+materialTableHeaderSize+i*materialEntrySize, "BOJ chunk out of range.");
+    }
+
+    valid = true;
+    return true;
+  }
+
+  //################################################################################################
+  bool readMetadata(size_t meshIndex, uint32_t& materialIndex, std::vector<std::string>& comments)
+  {
+    const Chunk& chunk = meshes.at(meshIndex).metadata;
+    std::string data;
+    if(!readChunk(chunk, data))
+      return fail(chunk.offset, "BOJ metadata buffer overflow.", meshIndex);
+
+    const char* p = data.data();
+    const char* pMax = p+data.size();
+    auto readInt = [&](uint32_t& n)
+    {
+      if((pMax-p)<4)
+        return false;
+      memcpy(&n, p, 4);
+      p+=4;
+      return true;
+    };
+
+    uint32_t count=0;
+    if(!readInt(materialIndex) || !readInt(count))
+      return fail(chunk.offset, "BOJ metadata buffer overflow.", meshIndex);
+
+    comments.clear();
+    for(uint32_t c=0; c<count; c++)
+    {
+      uint32_t length=0;
+      if(!readInt(length) || size_t(pMax-p)<length)
+        return fail(chunk.offset, "BOJ metadata buffer overflow.", meshIndex);
+      comments.emplace_back(p, length);
+      p+=length;
+    }
+
+    return true;
+  }
+
+  //################################################################################################
+  //! Append new metadata for a mesh and point its mesh table entry at it.
+  bool replaceMetadata(size_t meshIndex, const std::string& data)
+  {
+    Chunk chunk;
+    if(!append(data, chunk) || !sync())
+      return false;
+
+    auto& mesh = meshes.at(meshIndex);
+    unusedBytes += mesh.metadata.size;
+    mesh.metadata = chunk;
+
+    uint64_t entry = meshTableOffset + meshIndex*meshEntrySize;
+    if(!writeChunkEntry(entry+16, chunk))
+      return fail(entry, "Failed to write file.", meshIndex);
+
+    return finish();
+  }
+
+  //################################################################################################
+  //! Update the count of unused bytes, sync, and compact if the file has too many.
+  bool finish()
+  {
+    if(!writeUInt64(unusedBytesField, unusedBytes))
+      return fail(unusedBytesField, "Failed to write file.");
+
+    if(!sync())
+      return false;
+
+    if(options.maxUnusedRatio<1.0f && double(unusedBytes) > double(options.maxUnusedRatio)*double(fileSize))
+      return compact();
+
+    return true;
+  }
+
+  //################################################################################################
+  bool compact()
+  {
+    // Only the materials that are still used are kept, they are renumbered in order of first use
+    // like they are when the file is written.
+    std::vector<uint32_t> meshMaterials(meshes.size());
+    std::vector<std::string> metadata(meshes.size());
+    std::vector<uint32_t> remap(materials.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<size_t> used;
+    for(size_t m=0; m<meshes.size(); m++)
+    {
+      uint32_t materialIndex=0;
+      std::vector<std::string> comments;
+      if(!readMetadata(m, materialIndex, comments))
+        return false;
+
+      if(materialIndex>=materials.size())
+        return fail(meshes.at(m).metadata.offset, "BOJ material index out of range.", m);
+
+      auto& index = remap.at(materialIndex);
+      if(index==std::numeric_limits<uint32_t>::max())
+      {
+        index = uint32_t(used.size());
+        used.push_back(materialIndex);
+      }
+
+      metadata.at(m) = encodeMetadata(index, comments);
+    }
+
+    std::string boundsData;
+    if(!readChunk(bounds, boundsData))
+      return fail(bounds.offset, "BOJ bounds section out of range.");
+
+    // The same layout that the writer produces, the geometry of each mesh is copied as it is.
+    uint64_t newMeshTableOffset = fixedHeaderSize + bounds.size;
+    uint64_t newMaterialTableOffset = newMeshTableOffset + meshes.size()*meshEntrySize;
+    uint64_t newMaterialTableSize = materialTableHeaderSize + used.size()*materialEntrySize;
+
+    std::vector<uint64_t> materialOffsets;
+    std::vector<uint64_t> materialSizes;
+    uint64_t offset = newMaterialTableOffset + newMaterialTableSize;
+    for(size_t i : used)
+    {
+      materialOffsets.push_back(offset);
+      materialSizes.push_back(materialData.at(i).size());
+      offset += materialData.at(i).size();
+    }
+    offset += paddingSize(size_t(offset));
+
+    std::vector<MeshEntry> entries(meshes.size());
+    for(size_t m=0; m<meshes.size(); m++)
+    {
+      auto& entry = entries.at(m);
+      entry.geometry = {offset, meshes.at(m).geometry.size};
+      offset += entry.geometry.size;
+      offset += paddingSize(size_t(offset));
+      entry.metadata = {offset, metadata.at(m).size()};
+      offset += entry.metadata.size;
+      offset += paddingSize(size_t(offset));
+    }
+
+    std::string compactPath = filePath + ".compact";
+    {
+      std::ofstream out(compactPath, std::ios::binary|std::ios::trunc);
+      std::function<bool(const char*, size_t)> sink = [&](const char* data, size_t size)
+      {
+        out.write(data, std::streamsize(size));
+        return bool(out);
+      };
+      SinkWriter writer(sink, WriteOptions().blockSize);
+
+      writer.addInt(uint32_t(0)-maxVersion);
+      writer.addInt(uint32_t(meshes.size()));
+      writer.addUInt64(bounds.size);
+      writer.addUInt64(uint64_t(fixedHeaderSize));
+      writer.addUInt64(newMeshTableOffset);
+      writer.addUInt64(newMaterialTableOffset);
+      writer.addUInt64(newMaterialTableSize);
+      writer.addInt(uint32_t(blockAlignment));
+      writer.addInt(uint32_t(meshEntrySize));
+      writer.addUInt64(0); // Bytes of replaced chunks.
+
+      writer.addBytes(boundsData);
+
+      for(const auto& entry : entries)
+      {
+        writer.addUInt64(entry.geometry.offset);
+        writer.addUInt64(entry.geometry.size);
+        writer.addUInt64(entry.metadata.offset);
+        writer.addUInt64(entry.metadata.size);
+      }
+
+      writeMaterialTable(writer, materialOffsets, materialSizes);
+      for(size_t i : used)
+        writer.addBytes(materialData.at(i));
+      writer.addPadding();
+
+      std::string buffer(std::min(size_t(WriteOptions().blockSize), size_t(offset)), '\0');
+      for(size_t m=0; m<meshes.size() && writer.ok; m++)
+      {
+        const auto& geometry = meshes.at(m).geometry;
+        for(uint64_t copied=0; copied<geometry.size;)
+        {
+          size_t n = size_t(std::min(uint64_t(buffer.size()), geometry.size-copied));
+          if(!read(geometry.offset+copied, buffer.data(), n))
+          {
+            std::remove(compactPath.c_str());
+            return fail(geometry.offset+copied, "BOJ geometry out of range.", m);
+          }
+          writer.addRaw(buffer.data(), n);
+          copied+=n;
+        }
+        writer.addPadding();
+
+        writer.addBytes(metadata.at(m));
+        writer.addPadding();
+      }
+
+      writer.flush();
+      out.close();
+      if(!writer.ok || !out || !syncFile(compactPath))
+      {
+        std::remove(compactPath.c_str());
+        return fail(0, "Failed to write file.");
+      }
+    }
+
+    file.close();
+
+    std::error_code ec;
+    std::filesystem::rename(compactPath, filePath, ec);
+    if(ec)
+    {
+      std::remove(compactPath.c_str());
+      open();
+      return fail(0, "Failed to replace file: " + ec.message());
+    }
+
+    syncParentDirectory(filePath);
+    return open();
+  }
+};
+
+//##################################################################################################
+BOJPatcher::BOJPatcher(const std::string& filePath, const PatchOptions& options):
+  d(new Private(filePath, options))
+{
+  d->open();
+}
+
+//##################################################################################################
+BOJPatcher::~BOJPatcher()
+{
+  delete d;
+}
+
+//##################################################################################################
+bool BOJPatcher::isValid() const
+{
+  return d->valid;
+}
+
+//##################################################################################################
+const ReadError& BOJPatcher::error() const
+{
+  return d->error;
+}
+
+//##################################################################################################
+size_t BOJPatcher::meshCount() const
+{
+  return d->meshes.size();
+}
+
+//##################################################################################################
+size_t BOJPatcher::materialCount() const
+{
+  return d->materials.size();
+}
+
+//##################################################################################################
+size_t BOJPatcher::fileSize() const
+{
+  return size_t(d->fileSize);
+}
+
+//##################################################################################################
+size_t BOJPatcher::unusedBytes() const
+{
+  return size_t(d->unusedBytes);
+}
+
+//##################################################################################################
+bool BOJPatcher::setMeshComments(size_t meshIndex, const std::vector<std::string>& comments)
+{
+  if(!d->valid)
+    return false;
+
+  d->error = ReadError();
+  if(meshIndex>=d->meshes.size())
+    return d->fail(0, "Mesh index out of range.");
+
+  uint32_t materialIndex=0;
+  std::vector<std::string> oldComments;
+  if(!d->readMetadata(meshIndex, materialIndex, oldComments))
+    return false;
+
+  return d->replaceMetadata(meshIndex, Private::encodeMetadata(materialIndex, comments));
+}
+
+//##################################################################################################
+bool BOJPatcher::setMeshMaterial(size_t meshIndex, const tp_math_utils::Material& material)
+{
+  if(!d->valid)
+    return false;
+
+  d->error = ReadError();
+  if(meshIndex>=d->meshes.size())
+    return d->fail(0, "Mesh index out of range.");
+
+  uint32_t oldIndex=0;
+  std::vector<std::string> comments;
+  if(!d->readMetadata(meshIndex, oldIndex, comments))
+    return false;
+
+  std::string data = Private::encodeMaterial(material);
+  size_t materialIndex = size_t(std::find(d->materialData.begin(), d->materialData.end(), data) - d->materialData.begin());
+  if(materialIndex==oldIndex)
+    return true;
+
+  if(materialIndex==d->materials.size())
+  {
+    Private::Chunk chunk;
+    if(!d->append(data, chunk))
+      return false;
+
+    // The table has no room for another entry so a larger copy is appended and the header is
+    // pointed at that.
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> sizes;
+    for(const auto& material : d->materials)
+    {
+      offsets.push_back(material.offset);
+      sizes.push_back(material.size);
+    }
+    offsets.push_back(chunk.offset);
+    sizes.push_back(chunk.size);
+
+    Private::Chunk table;
+    if(!d->append(Private::encode([&](auto& writer){writeMaterialTable(writer, offsets, sizes);}), table) || !d->sync())
+      return false;
+
+    if(!d->writeChunkEntry(Private::materialTableOffsetField, table))
+      return d->fail(Private::materialTableOffsetField, "Failed to write file.");
+
+    d->unusedBytes += d->materialTable.size;
+    d->materialTable = table;
+    d->materials.push_back(chunk);
+    d->materialData.push_back(std::move(data));
+  }
+
+  return d->replaceMetadata(meshIndex, Private::encodeMetadata(uint32_t(materialIndex), comments));
+}
+
+//##################################################################################################
+bool BOJPatcher::setMaterial(size_t materialIndex, const tp_math_utils::Material& material)
+{
+  if(!d->valid)
+    return false;
+
+  d->error = ReadError();
+  if(materialIndex>=d->materials.size())
+    return d->fail(0, "Material index out of range.");
+
+  std::string data = Private::encodeMaterial(material);
+  if(data==d->materialData.at(materialIndex))
+    return true;
+
+  Private::Chunk chunk;
+  if(!d->append(data, chunk) || !d->sync())
+    return false;
+
+  uint64_t entry = d->materialTable.offset + materialTableHeaderSize + materialIndex*materialEntrySize;
+  if(!d->writeChunkEntry(entry, chunk))
+    return d->fail(entry, "Failed to write file.");
+
+  d->unusedBytes += d->materials.at(materialIndex).size;
+  d->materials.at(materialIndex) = chunk;
+  d->materialData.at(materialIndex) = std::move(data);
+  return d->finish();
+}
+
+//##################################################################################################
+bool BOJPatcher::compact()
+{
+  if(!d->valid)
+    return false;
+
+  d->error = ReadError();
+  return d->compact();
+}
+
+}
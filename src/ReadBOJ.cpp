@@ -1,27 +1,214 @@
 #include "tp_boj/ReadBOJ.h"
-
-#include "tp_math_utils/Geometry3D.h"
-#include "tp_math_utils/materials/OpenGLMaterial.h"
-#include "tp_math_utils/materials/LegacyMaterial.h"
+#include "tp_boj/MappedFile.h"
+#include "tp_boj/OptimizeMesh.h"
 
 #include "tp_utils/FileUtils.h"
-#include "tp_utils/DebugUtils.h"
-#include "tp_utils/JSONUtils.h"
 
-#include <stdexcept>
+#include "ReadBOJPrivate.h"
+
+#include <exception>
+#include <mutex>
+#include <memory>
+#include <utility>
 
 namespace tp_boj
 {
 
+namespace
+{
+//##################################################################################################
+void setError(const ReadOptions& options, size_t offset, size_t meshIndex, const std::string& reason)
+{
+  if(options.error)
+  {
+    options.error->offset = offset;
+    options.error->meshIndex = meshIndex;
+    options.error->reason = reason;
+  }
+}
+
+//##################################################################################################
+//! Read the header and validate the structure of the data, then call decode with an unchecked reader.
+/*!
+decode is passed the reader, the object count, and a mesh index that it should keep up to date so
+that errors can be reported against the mesh being read. Errors in the data, and exceptions thrown
+by the library while decoding it, are reported in options.error. Exceptions thrown by the caller's
+callbacks must be wrapped with callCallback, these are rethrown as they were.
+*/
+template<typename Decode>
+bool readValidated(const char* data, size_t size, const ReadOptions& options, const Decode& decode)
+{
+  Reader<true> reader(data, size);
+  reader.stats = options.stats;
+  ScopedTimer timer(reader.timer(&ReadStats::totalSeconds));
+
+  if(options.error)
+    *options.error = ReadError();
+
+  size_t meshIndex = ReadError::noMesh;
+  try
+  {
+    uint32_t objCount=0;
+    {
+      ScopedTimer timer(reader.timer(&ReadStats::headerSeconds));
+      bool ok = reader.readHeader(objCount);
+
+      if(reader.stats)
+      {
+        reader.stats->version = reader.version;
+        reader.stats->bytes += size;
+      }
+
+      if(!ok)
+      {
+        setError(options, 0, meshIndex, "Unsupported BOJ version.");
+        return false;
+      }
+    }
+
+    {
+      ScopedTimer timer(reader.timer(&ReadStats::validateSeconds));
+      reader.validate(objCount, meshIndex);
+    }
+
+    Reader<false> unchecked = reader.clone<false>();
+    return decode(unchecked, objCount, meshIndex);
+  }
+  catch(const CallbackFailure& e)
+  {
+    std::rethrow_exception(e.exception);
+  }
+  catch(const ReadFailure& e)
+  {
+    setError(options, e.offset, meshIndex, e.what());
+  }
+  catch(const std::exception& e)
+  {
+    setError(options, 0, meshIndex, e.what());
+  }
+  catch(...)
+  {
+    setError(options, 0, meshIndex, "Unknown error.");
+  }
+
+  return false;
+}
+
+//##################################################################################################
+//! Add the stats collected while decoding a mesh on another thread.
+void addMeshStats(ReadStats& stats, const ReadStats& meshStats)
+{
+  stats.meshes           += meshStats.meshes;
+  stats.verts            += meshStats.verts;
+  stats.indexes          += meshStats.indexes;
+  stats.materials        += meshStats.materials;
+  stats.vertsSeconds     += meshStats.vertsSeconds;
+  stats.indexesSeconds   += meshStats.indexesSeconds;
+  stats.materialsSeconds += meshStats.materialsSeconds;
+}
+
+//##################################################################################################
+//! Read every mesh into object, in parallel if the file has a mesh table and options allow it.
+/*!
+readMesh(reader, m, mesh, meshStats) reads mesh m and returns false if it was rejected by the filters.
+*/
+template<typename Mesh, typename ReadMesh>
+void readMeshes(Reader<false>& reader, uint32_t objCount, size_t& meshIndex, const ReadOptions& options, std::vector<Mesh>& object, const ReadMesh& readMesh)
+{
+  if(reader.meshTable.empty() || options.maxThreads==1)
+  {
+    for(meshIndex=0; meshIndex<objCount; meshIndex++)
+      if(!readMesh(reader, meshIndex, object.emplace_back(), reader.stats))
+        object.pop_back();
+    return;
+  }
+
+  // The mesh table has been validated so meshes can be decoded independently.
+  object.resize(objCount);
+  std::vector<char> loaded(objCount, 0);
+  std::vector<ReadStats> meshStats(options.stats?objCount:0);
+
+  // Keep the error from the first mesh that failed so the result does not depend on timing.
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  size_t errorMesh = ReadError::noMesh;
+
+  parallelFor(objCount, options.maxThreads, [&](size_t m)
+  {
+    try
+    {
+      loaded[m] = readMesh(reader, m, object.at(m), meshStats.empty()?nullptr:&meshStats.at(m));
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if(m<errorMesh)
+      {
+        errorMesh = m;
+        error = std::current_exception();
+      }
+    }
+  });
+
+  for(const auto& s : meshStats)
+    addMeshStats(*options.stats, s);
+
+  if(error)
+  {
+    meshIndex = errorMesh;
+    std::rethrow_exception(error);
+  }
+
+  // Remove meshes that were rejected by the filters.
+  size_t c=0;
+  for(size_t m=0; m<object.size(); m++)
+    if(loaded[m])
+    {
+      if(c!=m)
+        object[c] = std::move(object[m]);
+      c++;
+    }
+  object.resize(c);
+}
+}
+
 //##################################################################################################
 std::vector<tp_math_utils::Geometry3D> readObjectAndTexturesFromFile(const std::string& filePath,
                                                                      std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
                                                                      const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
+{
+  return readObjectAndTexturesFromFile(filePath, texturePaths, extractTextureIDs, ReadOptions());
+}
+
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> readObjectAndTexturesFromFile(const std::string& filePath,
+                                                                     std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                                                     const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                                                     const ReadOptions& options)
 {
   std::string directory = getAssociatedFilePath(filePath);
+  ReadStats* stats = options.stats;
+
+  std::vector<tp_math_utils::Geometry3D> geometry;
+  {
+    std::unique_ptr<MappedFile> file;
+    {
+      ScopedTimer timer(stats?&stats->fileSeconds:nullptr);
+      ScopedTimer totalTimer(stats?&stats->totalSeconds:nullptr);
+      file = std::make_unique<MappedFile>(filePath);
+    }
+
+    if(!file->isValid())
+    {
+      setError(options, 0, ReadError::noMesh, "Failed to open file.");
+      return geometry;
+    }
 
-  std::vector<tp_math_utils::Geometry3D> geometry = deserializeObject(tp_utils::readBinaryFile(filePath));
+    geometry = deserializeObject(file->data(), file->size(), options);
+  }
 
+  ScopedTimer timer(stats?&stats->texturesSeconds:nullptr);
+  ScopedTimer totalTimer(stats?&stats->totalSeconds:nullptr);
 
   std::unordered_set<tp_utils::StringID> textures;
   for(const auto& mesh : geometry)
@@ -34,378 +221,168 @@ std::vector<tp_math_utils::Geometry3D> readObjectAndTexturesFromFile(const std::
 }
 
 //##################################################################################################
-std::vector<tp_math_utils::Geometry3D> deserializeObject(const std::string& data)
+bool readObjectAndTexturesFromFile(const std::string& filePath,
+                                   std::unordered_map<tp_utils::StringID, std::string>& texturePaths,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const ReadOptions& options,
+                                   const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded)
 {
-  uint32_t maxVersion=20;
-
-  auto p = data.data();
-  auto pMax = p + data.size();
+  std::string directory = getAssociatedFilePath(filePath);
+  ReadStats* stats = options.stats;
 
-  auto readInt = [&]()
+  std::unique_ptr<MappedFile> file;
   {
-    if((pMax-p) < 4)
-      throw std::logic_error("BOJ readInt buffer overflow.");
-
-    uint32_t n;
-    memcpy(&n, p, 4);
-    p+=4;
-    return n;
-  };
+    ScopedTimer timer(stats?&stats->fileSeconds:nullptr);
+    ScopedTimer totalTimer(stats?&stats->totalSeconds:nullptr);
+    file = std::make_unique<MappedFile>(filePath);
+  }
 
-  auto readFloat = [&]()
+  if(!file->isValid())
   {
-    if((pMax-p) < 4)
-      throw std::logic_error("BOJ readFloat buffer overflow.");
-
-    float n;
-    memcpy(&n, p, 4);
-    p+=4;
-    return n;
-  };
+    setError(options, 0, ReadError::noMesh, "Failed to open file.");
+    return false;
+  }
 
-  auto readString = [&]()
+  return deserializeObject(file->data(), file->size(), options, [&](tp_math_utils::Geometry3D& mesh)
   {
-    if((pMax-p) < 4)
-      throw std::logic_error("BOJ readString buffer overflow.");
+    ScopedTimer timer(stats?&stats->texturesSeconds:nullptr);
+    std::unordered_set<tp_utils::StringID> textures;
+    mesh.material.allTextureIDs(textures, extractTextureIDs);
 
-    uint32_t n;
-    memcpy(&n, p, 4);
-    p+=4;
+    for(const auto& name : textures)
+      texturePaths[name] = directory + name.toString() + ".png";
 
-    std::string str;
-    str.resize(n);
+    return meshDecoded(mesh);
+  });
+}
 
-    if((pMax-p) < n)
-      throw std::logic_error("BOJ readString buffer overflow.");
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> deserializeObject(const std::string& data)
+{
+  return deserializeObject(data.data(), data.size());
+}
 
-    memcpy(str.data(), p, n);
-    p+=n;
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> deserializeObject(const char* data, size_t size)
+{
+  return deserializeObject(data, size, ReadOptions());
+}
 
-    return str;
-  };
+//##################################################################################################
+std::vector<tp_math_utils::Geometry3D> deserializeObject(const char* data, size_t size, const ReadOptions& options)
+{
+  std::vector<tp_math_utils::Geometry3D> object;
 
-  try
+  bool ok = readValidated(data, size, options, [&](Reader<false>& reader, uint32_t objCount, size_t& meshIndex)
   {
-    uint32_t objCount = readInt();
-    uint32_t version=0;
+    readMeshes(reader, objCount, meshIndex, options, object, [&](auto& reader, size_t m, auto& mesh, ReadStats* meshStats)
+    {
+      return reader.readMesh(m, mesh, options, meshStats);
+    });
+    return true;
+  });
+
+  if(!ok)
+    return std::vector<tp_math_utils::Geometry3D>();
 
-    for(uint32_t v=maxVersion; v; v--)
+  return object;
+}
+
+//##################################################################################################
+bool deserializeObject(const char* data, size_t size, const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded)
+{
+  return deserializeObject(data, size, ReadOptions(), meshDecoded);
+}
+
+//##################################################################################################
+bool deserializeObject(const char* data, size_t size, const ReadOptions& options, const std::function<bool(tp_math_utils::Geometry3D&)>& meshDecoded)
+{
+  return readValidated(data, size, options, [&](Reader<false>& reader, uint32_t objCount, size_t& meshIndex)
+  {
+    for(meshIndex=0; meshIndex<objCount; meshIndex++)
     {
-      if(objCount == (uint32_t(0)-v))
-      {
-        version = v;
-        objCount = readInt();
+      tp_math_utils::Geometry3D mesh;
+      if(reader.readMesh(meshIndex, mesh, options) && !callCallback(meshDecoded, mesh))
         break;
-      }
     }
 
-    if(version==0)
+    return true;
+  });
+}
+
+//##################################################################################################
+bool deserializeObjectProgressive(const char* data,
+                                  size_t size,
+                                  const ReadOptions& options,
+                                  const std::function<bool(size_t meshIndex, size_t lod, tp_math_utils::Geometry3D&)>& meshDecoded)
+{
+  return readValidated(data, size, options, [&](Reader<false>& reader, uint32_t objCount, size_t& meshIndex)
+  {
+    std::vector<size_t> lodCounts(objCount, 1);
+    size_t levels=1;
+    for(size_t m=0; m<lodCounts.size(); m++)
     {
-      uint32_t fileVersion = uint32_t(0)-objCount;
-      if(fileVersion<10000)
-      {
-        tpWarning() << "Failed to deserialize model, BOJ file version: " << fileVersion << " max supported version: " << maxVersion;
-        return std::vector<tp_math_utils::Geometry3D>();
-      }
+      lodCounts[m] = reader.lodCount(m);
+      levels = std::max(levels, lodCounts[m]);
     }
 
-    std::vector<tp_math_utils::Geometry3D> object;
-    object.resize(size_t(objCount));
-    for(auto& mesh : object)
+    // The first pass loads the coarsest level of every mesh, later passes only the meshes that have
+    // the level being refined to.
+    ReadOptions levelOptions = options;
+    size_t finest = std::min(options.lod, levels-1);
+    for(size_t level=levels; level-- > finest;)
     {
-      mesh.comments.resize(size_t(readInt()));
-      for(auto& comment : mesh.comments)
-        comment = readString();
-
-      mesh.verts.resize(size_t(readInt()));
-      for(auto& vert : mesh.verts)
+      levelOptions.lod = level;
+      for(meshIndex=0; meshIndex<objCount; meshIndex++)
       {
-        vert.vert.x = readFloat();
-        vert.vert.y = readFloat();
-        vert.vert.z = readFloat();
-
-        if(version<18)
-        {
-          readFloat(); // vert.color.x
-          readFloat(); // vert.color.y
-          readFloat(); // vert.color.z
-          readFloat(); // vert.color.w
-        }
-
-        vert.texture.x = readFloat();
-        vert.texture.y = readFloat();
-
-        vert.normal.x = readFloat();
-        vert.normal.y = readFloat();
-        vert.normal.z = readFloat();
-
-        if(version<4)
-        {
-          readFloat();
-          readFloat();
-          readFloat();
-
-          readFloat();
-          readFloat();
-          readFloat();
-        }
-      }
+        if(level!=levels-1 && level>=lodCounts[meshIndex])
+          continue;
 
-      mesh.indexes.resize(size_t(readInt()));
-      for(auto& index : mesh.indexes)
-      {
-        switch(readInt())
-        {
-          case 1:  index.type = mesh.triangleFan;   break;
-          case 2:  index.type = mesh.triangleStrip; break;
-          default: index.type = mesh.triangles;     break;
-        }
-
-        index.indexes.resize(size_t(readInt()));
-        for(int& i : index.indexes)
-          i = int(readInt());
+        tp_math_utils::Geometry3D mesh;
+        size_t lod = std::min(level, lodCounts[meshIndex]-1);
+        if(reader.readMesh(meshIndex, mesh, levelOptions) && !callCallback(meshDecoded, meshIndex, lod, mesh))
+          return true;
       }
+    }
 
-      mesh.material.name = readString();
+    return true;
+  });
+}
 
-      if(version<20)
-      {
-        auto openGLMaterial = mesh.material.findOrAddOpenGL();
-        auto legacyMaterial = mesh.material.findOrAddLegacy();
-
-        if(version>16)
-        {
-          legacyMaterial->shaderType = tp_math_utils::ShaderType(readInt());
-        }
-
-        openGLMaterial->albedo.x = readFloat();
-        openGLMaterial->albedo.y = readFloat();
-        openGLMaterial->albedo.z = readFloat();
-
-        if(version<3)
-        {
-          openGLMaterial->albedo.x = readFloat();
-          openGLMaterial->albedo.y = readFloat();
-          openGLMaterial->albedo.z = readFloat();
-        }
-
-        if(version<6)
-        {
-          readFloat(); // specular
-          readFloat(); // specular
-          readFloat(); // specular
-        }
-
-        if(version<3)
-          readFloat();
-
-        openGLMaterial->alpha = readFloat();
-
-        if(version>2)
-        {
-          openGLMaterial->roughness       = readFloat();
-          openGLMaterial->metalness       = readFloat();
-
-          if(version>4)
-          {
-            openGLMaterial->transmission  = readFloat();
-            if(version>7)
-              openGLMaterial->transmissionRoughness  = readFloat();
-
-            legacyMaterial->ior           = readFloat();
-
-            if(version>6)
-            {
-              legacyMaterial->sheen              = readFloat();
-              legacyMaterial->sheenTint          = readFloat();
-              legacyMaterial->clearCoat          = readFloat();
-              legacyMaterial->clearCoatRoughness = readFloat();
-
-              if(version>9)
-              {
-                legacyMaterial->   iridescentFactor = readFloat();
-                legacyMaterial->   iridescentOffset = readFloat();
-                legacyMaterial->iridescentFrequency = readFloat();
-
-                if(version>10)
-                {
-                  legacyMaterial->  specular        = readFloat();
-                }
-              }
-            }
-
-            legacyMaterial->sssScale      = readFloat();
-
-            legacyMaterial->sssRadius.x   = readFloat();
-            legacyMaterial->sssRadius.y   = readFloat();
-            legacyMaterial->sssRadius.z   = readFloat();
-
-            if(version>11)
-            {
-              if(version>15)
-              {
-                legacyMaterial->sssMethod = tp_math_utils::SSSMethod(readInt());
-                legacyMaterial->normalStrength = readFloat();
-              }
-
-              openGLMaterial->albedoBrightness = readFloat();
-              openGLMaterial->albedoContrast   = readFloat();
-              openGLMaterial->albedoGamma      = readFloat();
-              openGLMaterial->albedoHue        = readFloat();
-              openGLMaterial->albedoSaturation = readFloat();
-              openGLMaterial->albedoValue      = readFloat();
-              openGLMaterial->albedoFactor     = readFloat();
-            }
-
-            legacyMaterial->sss.x         = readFloat();
-            legacyMaterial->sss.y         = readFloat();
-            legacyMaterial->sss.z         = readFloat();
-
-            legacyMaterial->emission.x    = readFloat();
-            legacyMaterial->emission.y    = readFloat();
-            legacyMaterial->emission.z    = readFloat();
-
-            legacyMaterial->emissionScale = readFloat();
-
-            if(version>6)
-            {
-              legacyMaterial->velvet.x    = readFloat();
-              legacyMaterial->velvet.y    = readFloat();
-              legacyMaterial->velvet.z    = readFloat();
-
-              legacyMaterial->velvetScale = readFloat();
-            }
-
-            if(version>5)
-            {
-              legacyMaterial->heightScale    = readFloat();
-              legacyMaterial->heightMidlevel = readFloat();
-            }
-          }
-
-          openGLMaterial->useAmbient     = readFloat();
-          openGLMaterial->useDiffuse     = readFloat();
-          openGLMaterial->useNdotL       = readFloat();
-          openGLMaterial->useAttenuation = readFloat();
-          openGLMaterial->useShadow      = readFloat();
-          openGLMaterial->useLightMask   = readFloat();
-          openGLMaterial->useReflection  = readFloat();
-        }
-
-
-        if(version>0)
-        {
-          if(version<3)
-            readFloat();
-
-          openGLMaterial->albedoScale   = readFloat();
-          if(version<6)
-            readFloat(); //specularScale
-        }
-
-        if(version>1)
-        {
-          openGLMaterial->tileTextures = readInt();
-
-          if(version>12)
-          {
-            mesh.material.uvTransformation.skewUV.x      = readFloat();
-            mesh.material.uvTransformation.skewUV.y      = readFloat();
-            mesh.material.uvTransformation.scaleUV.x     = readFloat();
-            mesh.material.uvTransformation.scaleUV.y     = readFloat();
-            mesh.material.uvTransformation.translateUV.x = readFloat();
-            mesh.material.uvTransformation.translateUV.y = readFloat();
-            mesh.material.uvTransformation.rotateUV      = readFloat();
-
-            if(version>13)
-            {
-              legacyMaterial->rayVisibilityCamera       = readInt();
-              legacyMaterial->rayVisibilityDiffuse      = readInt();
-              legacyMaterial->rayVisibilityGlossy       = readInt();
-              legacyMaterial->rayVisibilityTransmission = readInt();
-              legacyMaterial->rayVisibilityScatter      = readInt();
-              legacyMaterial->rayVisibilityShadow       = readInt();
-
-              if(version>14)
-                openGLMaterial->rayVisibilityShadowCatcher = readInt();
-            }
-          }
-        }
-
-        if(version<3)
-          readString();
-
-        openGLMaterial->albedoTexture  = readString();
-        if(version<6)
-          readString(); //specularTexture
-        openGLMaterial->alphaTexture    = readString();
-        openGLMaterial->normalsTexture  = readString();
-
-        if(version>2)
-        {
-          openGLMaterial->roughnessTexture = readString();
-          openGLMaterial->metalnessTexture = readString();
-          if(version<6)
-            readString(); //aoTexture
-          else
-          {
-            legacyMaterial->emissionTexture = readString();
-            legacyMaterial->     sssTexture = readString();
-            legacyMaterial->  heightTexture = readString();
-            if(version>6)
-            {
-              openGLMaterial->         transmissionTexture = readString();
-              openGLMaterial->transmissionRoughnessTexture = readString();
-              legacyMaterial->                sheenTexture = readString();
-              legacyMaterial->            sheenTintTexture = readString();
-              legacyMaterial->            clearCoatTexture = readString();
-              legacyMaterial->   clearCoatRoughnessTexture = readString();
-              legacyMaterial->               velvetTexture = readString();
-              legacyMaterial->         velvetFactorTexture = readString();
-
-              if(version>8)
-              {
-                legacyMaterial->           sssScaleTexture = readString();
-                legacyMaterial->   iridescentFactorTexture = readString();
-                legacyMaterial->   iridescentOffsetTexture = readString();
-                legacyMaterial->iridescentFrequencyTexture = readString();
-
-                if(version>10)
-                {
-                  legacyMaterial->         specularTexture = readString();
-
-                  if(version>18)
-                  {
-                    openGLMaterial->           rgbaTexture = readString();
-                    openGLMaterial->          rmttrTexture = readString();
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-      else
-      {
-        // Version 20+
-        mesh.material.loadState(tp_utils::jsonFromString(readString()));
-
-        mesh.material.uvTransformation.skewUV.x      = readFloat();
-        mesh.material.uvTransformation.skewUV.y      = readFloat();
-        mesh.material.uvTransformation.scaleUV.x     = readFloat();
-        mesh.material.uvTransformation.scaleUV.y     = readFloat();
-        mesh.material.uvTransformation.translateUV.x = readFloat();
-        mesh.material.uvTransformation.translateUV.y = readFloat();
-        mesh.material.uvTransformation.rotateUV      = readFloat();
-      }
-    }
+//##################################################################################################
+std::vector<RenderMesh> deserializeRenderMeshes(const char* data, size_t size, const ReadOptions& options, const RenderReadOptions& renderOptions)
+{
+  std::vector<RenderMesh> object;
 
-    return object;
-  }
-  catch(...)
+  bool ok = readValidated(data, size, options, [&](Reader<false>& reader, uint32_t objCount, size_t& meshIndex)
   {
-    return std::vector<tp_math_utils::Geometry3D>();
-  }
+    readMeshes(reader, objCount, meshIndex, options, object, [&](auto& reader, size_t m, auto& mesh, ReadStats* meshStats)
+    {
+      return reader.readRenderMesh(m, mesh, options, renderOptions, meshStats);
+    });
+    return true;
+  });
+
+  if(!ok)
+    return std::vector<RenderMesh>();
+
+  return object;
+}
+
+//##################################################################################################
+bool deserializeRenderMeshes(const char* data, size_t size, const ReadOptions& options, const RenderReadOptions& renderOptions, const std::function<bool(RenderMesh&)>& meshDecoded)
+{
+  return readValidated(data, size, options, [&](Reader<false>& reader, uint32_t objCount, size_t& meshIndex)
+  {
+    for(meshIndex=0; meshIndex<objCount; meshIndex++)
+    {
+      RenderMesh mesh;
+      if(reader.readRenderMesh(meshIndex, mesh, options, renderOptions, reader.stats) && !callCallback(meshDecoded, mesh))
+        break;
+    }
+
+    return true;
+  });
 }
 
 }
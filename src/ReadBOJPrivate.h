@@ -0,0 +1,1776 @@
+#ifndef tp_boj_ReadBOJPrivate_h
+#define tp_boj_ReadBOJPrivate_h
+
+#include "tp_boj/ReadBOJ.h"
+#include "tp_boj/Compression.h"
+
+#include "tp_math_utils/Geometry3D.h"
+#include "tp_math_utils/materials/OpenGLMaterial.h"
+#include "tp_math_utils/materials/LegacyMaterial.h"
+
+#include "tp_utils/DebugUtils.h"
+#include "tp_utils/JSONUtils.h"
+
+#include <stdexcept>
+#include <exception>
+#include <utility>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <array>
+
+//! The Reader and the decoding helpers shared by ReadBOJ.cpp and BOJView.cpp. This is not part of
+//! the public interface.
+
+namespace tp_boj
+{
+
+//##################################################################################################
+static_assert(sizeof(int) == sizeof(uint32_t), "Indexes are copied straight from uint32_t to int.");
+
+//##################################################################################################
+//! Decode count vertex records from src, the caller must have checked the size.
+/*!
+Each family of versions has a fixed record layout, these are instantiated once per layout so that
+the inner loop has no version checks.
+
+\tparam Floats The number of floats in each record.
+\tparam Texture The index of the first texture coordinate in the record.
+\tparam Normal The index of the first normal component in the record.
+*/
+template<size_t Floats, size_t Texture, size_t Normal>
+void decodeVertices(const char* src, tp_math_utils::Vertex3D* dst, size_t count)
+{
+  using Vertex3D = tp_math_utils::Vertex3D;
+  constexpr size_t recordSize = Floats*sizeof(float);
+
+  // If Vertex3D has the same layout as the file record we can copy the whole block in one go.
+  if constexpr(sizeof(Vertex3D) == recordSize &&
+               std::is_trivially_copyable_v<Vertex3D> &&
+               offsetof(Vertex3D, vert)    == 0*sizeof(float) &&
+               offsetof(Vertex3D, texture) == Texture*sizeof(float) &&
+               offsetof(Vertex3D, normal)  == Normal*sizeof(float))
+  {
+    if(count)
+      memcpy(static_cast<void*>(dst), src, count*recordSize);
+  }
+  else
+  {
+    for(const Vertex3D* dstMax=dst+count; dst<dstMax; dst++, src+=recordSize)
+    {
+      float f[Floats];
+      memcpy(f, src, recordSize);
+
+      dst->vert.x    = f[0];
+      dst->vert.y    = f[1];
+      dst->vert.z    = f[2];
+
+      dst->texture.x = f[Texture+0];
+      dst->texture.y = f[Texture+1];
+
+      dst->normal.x  = f[Normal+0];
+      dst->normal.y  = f[Normal+1];
+      dst->normal.z  = f[Normal+2];
+    }
+  }
+}
+
+//##################################################################################################
+//! Decode count vertex records from src into 8 float interleaved render vertices.
+template<size_t Floats, size_t Texture, size_t Normal>
+void decodeInterleavedVertices(const char* src, float* dst, size_t count)
+{
+  constexpr size_t recordSize = Floats*sizeof(float);
+
+  // Version 18+ records are already in the interleaved layout.
+  if constexpr(Floats==8 && Texture==3 && Normal==5)
+  {
+    if(count)
+      memcpy(dst, src, count*recordSize);
+  }
+  else
+  {
+    for(const float* dstMax=dst+count*8; dst<dstMax; dst+=8, src+=recordSize)
+    {
+      memcpy(dst+0, src,                       3*sizeof(float));
+      memcpy(dst+3, src+Texture*sizeof(float), 2*sizeof(float));
+      memcpy(dst+5, src+Normal*sizeof(float),  3*sizeof(float));
+    }
+  }
+}
+
+//##################################################################################################
+//! Decode count vertex records from src into separate position, texture, and normal arrays.
+template<size_t Floats, size_t Texture, size_t Normal>
+void decodeSoAVertices(const char* src, const RenderVertexBuffers& dst, size_t count)
+{
+  constexpr size_t recordSize = Floats*sizeof(float);
+
+  for(size_t v=0; v<count; v++, src+=recordSize)
+  {
+    memcpy(dst.positions+v*3, src,                       3*sizeof(float));
+    memcpy(dst.textures +v*2, src+Texture*sizeof(float), 2*sizeof(float));
+    memcpy(dst.normals  +v*3, src+Normal*sizeof(float),  3*sizeof(float));
+  }
+}
+
+//##################################################################################################
+//! The size and decode functions for the vertex records of a version.
+struct VertexFormat
+{
+  size_t recordSize{0};
+  void (*decode)(const char*, tp_math_utils::Vertex3D*, size_t){nullptr};
+  void (*decodeInterleaved)(const char*, float*, size_t){nullptr};
+  void (*decodeSoA)(const char*, const RenderVertexBuffers&, size_t){nullptr};
+};
+
+//##################################################################################################
+template<size_t Floats, size_t Texture, size_t Normal>
+constexpr VertexFormat makeVertexFormat()
+{
+  return
+  {
+    Floats*sizeof(float),
+    &decodeVertices<Floats, Texture, Normal>,
+    &decodeInterleavedVertices<Floats, Texture, Normal>,
+    &decodeSoAVertices<Floats, Texture, Normal>
+  };
+}
+
+//##################################################################################################
+inline VertexFormat vertexFormat(uint32_t version)
+{
+  // Versions before 18 have a color after the position, versions before 4 also have 6 unused
+  // floats at the end of each record.
+  if(version<4)
+    return makeVertexFormat<18, 7, 9>();
+
+  if(version<18)
+    return makeVertexFormat<12, 7, 9>();
+
+  return makeVertexFormat<8, 3, 5>();
+}
+
+//##################################################################################################
+//! Widen count packed indexes of type T to int, written so that the compiler can vectorize it.
+template<typename T>
+void widenIndexes(const uint8_t* src, int* dst, size_t count)
+{
+  for(size_t i=0; i<count; i++)
+  {
+    T n;
+    memcpy(&n, src+i*sizeof(T), sizeof(T));
+    dst[i] = int(n);
+  }
+}
+
+//##################################################################################################
+//! Returns false if the varint runs past pMax or is longer than 64 bits.
+inline bool readVarint(const uint8_t*& p, const uint8_t* pMax, uint64_t& n)
+{
+  n=0;
+  for(int shift=0; shift<64; shift+=7)
+  {
+    if(p>=pMax)
+      return false;
+
+    uint8_t b = *(p++);
+    n |= uint64_t(b&0x7F)<<shift;
+    if(!(b&0x80))
+      return true;
+  }
+
+  return false;
+}
+
+//##################################################################################################
+constexpr uint32_t maxVersion=29;
+
+//##################################################################################################
+//! Version 28+ mesh blocks, vertex records, and index payloads are aligned to this, this must match
+//! WriteBOJPrivate.h.
+constexpr size_t blockAlignment=64;
+
+//##################################################################################################
+inline size_t paddingSize(size_t offset)
+{
+  return (blockAlignment - offset%blockAlignment) % blockAlignment;
+}
+
+//##################################################################################################
+//! Location of a mesh block in a version 21+ file.
+struct MeshRange
+{
+  uint64_t offset{0};
+  uint64_t size{0};
+
+  //! Version 29+ the location of the material index and comments.
+  uint64_t metadataOffset{0};
+  uint64_t metadataSize{0};
+};
+
+//##################################################################################################
+//! The number of triangle list indexes an index array flattens to, type is the value stored in the
+//! file.
+inline size_t flattenedIndexCount(uint32_t type, size_t count)
+{
+  if(type==1 || type==2)
+    return (count>2)?(count-2)*3:0;
+  return count - count%3;
+}
+
+//##################################################################################################
+//! Read a packed index of type T and advance src past it.
+template<typename T>
+uint32_t loadIndex(const uint8_t*& src)
+{
+  T i;
+  memcpy(&i, src, sizeof(T));
+  src+=sizeof(T);
+  return uint32_t(i);
+}
+
+//##################################################################################################
+//! Flatten an index array to a triangle list as it is decoded, following the winding of strips.
+/*!
+next returns each index of the array in turn, strips and fans only need the previous two indexes so
+the array is never held. Any incomplete triangle at the end of a triangle list is dropped, the same
+as forEachTriangle. Returns the end of the indexes written to dst.
+*/
+template<typename T, typename Next>
+T* flattenIndexArray(uint32_t type, size_t count, const Next& next, T* dst)
+{
+  if(type==1 || type==2)
+  {
+    if(count<3)
+    {
+      for(size_t n=0; n<count; n++)
+        next();
+      return dst;
+    }
+
+    uint32_t first = next();
+    uint32_t a = first;
+    uint32_t b = next();
+    for(size_t n=2; n<count; n++, dst+=3)
+    {
+      uint32_t c = next();
+      if(type==1)
+      {
+        dst[0] = T(first);
+        dst[1] = T(b);
+      }
+      else if(n&1)
+      {
+        dst[0] = T(b);
+        dst[1] = T(a);
+      }
+      else
+      {
+        dst[0] = T(a);
+        dst[1] = T(b);
+      }
+      dst[2] = T(c);
+      a = b;
+      b = c;
+    }
+    return dst;
+  }
+
+  size_t kept = count - count%3;
+  for(size_t n=0; n<kept; n++)
+    dst[n] = T(next());
+  for(size_t n=kept; n<count; n++)
+    next();
+  return dst+kept;
+}
+
+//##################################################################################################
+inline void addGeometryStats(ReadStats& stats, const tp_math_utils::Geometry3D& mesh)
+{
+  stats.verts += mesh.verts.size();
+  for(const auto& indexes : mesh.indexes)
+    stats.indexes += indexes.indexes.size();
+}
+
+//##################################################################################################
+inline void addGeometryStats(ReadStats& stats, const RenderMesh& mesh)
+{
+  stats.verts += mesh.vertexCount;
+  stats.indexes += mesh.indexCount;
+}
+
+//##################################################################################################
+//! Thrown by Reader when the data is invalid, offset is from the start of the data.
+struct ReadFailure : public std::logic_error
+{
+  size_t offset;
+
+  //################################################################################################
+  ReadFailure(const std::string& reason, size_t offset_):
+    std::logic_error(reason),
+    offset(offset_)
+  {
+
+  }
+};
+
+//##################################################################################################
+//! Carries an exception thrown by one of the caller's callbacks out through the reader.
+/*!
+readValidated rethrows the original exception so that a bug in a callback is not reported as a
+ReadError against valid data.
+*/
+struct CallbackFailure
+{
+  std::exception_ptr exception;
+};
+
+//##################################################################################################
+//! Call one of the caller's callbacks, wrapping anything it throws in a CallbackFailure.
+template<typename Callback, typename... Args>
+decltype(auto) callCallback(const Callback& callback, Args&&... args)
+{
+  try
+  {
+    return callback(std::forward<Args>(args)...);
+  }
+  catch(...)
+  {
+    throw CallbackFailure{std::current_exception()};
+  }
+}
+
+//##################################################################################################
+//! The size of a version 0-19 material after its name.
+/*!
+Legacy materials are a name, a block of ints and floats, and a list of texture names. This must be
+kept in sync with Reader::readLegacyMaterialVersion.
+*/
+struct LegacyMaterialLayout
+{
+  size_t numericBytes{0};
+  size_t strings{0};
+};
+
+//##################################################################################################
+constexpr LegacyMaterialLayout legacyMaterialLayout(uint32_t version)
+{
+  size_t n=4; // albedo, alpha
+
+  if(version>16) n+=1;  // shaderType
+  if(version<3)  n+=4;
+  if(version<6)  n+=3;  // specular
+
+  if(version>2)
+  {
+    n+=9; // roughness, metalness, use flags
+
+    if(version>4)
+    {
+      n+=13; // transmission, ior, sss, emission
+      if(version>7)  n+=1;
+      if(version>6)  n+=8; // sheen, clear coat, velvet
+      if(version>9)  n+=3; // iridescence
+      if(version>10) n+=1; // specular
+      if(version>11) n+=7; // albedo adjustments
+      if(version>15) n+=2; // sssMethod, normalStrength
+      if(version>5)  n+=2; // height
+    }
+  }
+
+  if(version>0)
+  {
+    n+=1; // albedoScale
+    if(version<3) n+=1;
+    if(version<6) n+=1;
+  }
+
+  if(version>1)  n+=1; // tileTextures
+  if(version>12) n+=7; // uvTransformation
+  if(version>13) n+=6; // ray visibility
+  if(version>14) n+=1; // shadow catcher
+
+  size_t s=3; // albedo, alpha, normals
+  if(version<3)  s+=1;
+  if(version<6)  s+=1; // specular
+  if(version>2)  s+=(version<6)?3:5;
+  if(version>6)  s+=8;
+  if(version>8)  s+=4;
+  if(version>10) s+=1;
+  if(version>18) s+=2;
+
+  return {n*4, s};
+}
+
+//##################################################################################################
+//! Reads .boj data, if Checked is false every read trusts the data, use validate first.
+template<bool Checked>
+struct Reader
+{
+  //! Offset of pMin from the start of the data, used to report errors.
+  size_t baseOffset{0};
+  const char* pMin;
+  const char* p;
+  const char* pMax;
+  uint32_t version{0};
+
+  //! Version 21+ the offset and size of each mesh, empty for older files.
+  std::vector<MeshRange> meshTable;
+
+  //! Version 24+ the distinct materials in the file, meshes reference these by index.
+  std::shared_ptr<const std::vector<tp_math_utils::Material>> materials;
+  size_t materialCount{0};
+
+  //! If set readHeader fills this with the offset of each material rather than decoding them.
+  std::vector<size_t>* materialOffsets{nullptr};
+
+  //! Version 29+ the material index and comments of the mesh, set by meshReader.
+  const char* metadata{nullptr};
+  size_t metadataSize{0};
+  size_t metadataOffset{0};
+
+  //! If set counts and timings are added to this.
+  ReadStats* stats{nullptr};
+
+  //! Decoders for this version, these are selected once by setVersion.
+  using LegacyMaterialReader = void (Reader::*)(tp_math_utils::Material&);
+  VertexFormat vertexFormat;
+  LegacyMaterialReader readLegacyMaterial{nullptr};
+
+  //################################################################################################
+  Reader(const char* data, size_t size):
+    pMin(data),
+    p(data),
+    pMax(data+size)
+  {
+
+  }
+
+  //################################################################################################
+  void setVersion(uint32_t version_)
+  {
+    version = version_;
+    vertexFormat = tp_boj::vertexFormat(version);
+
+    if(version<20)
+      readLegacyMaterial = legacyMaterialReaders()[version];
+  }
+
+  //################################################################################################
+  //! Returns a reader for a block of this file that shares the version and decoders.
+  template<bool SubChecked=Checked>
+  Reader<SubChecked> subReader(const char* data, size_t size, size_t offset) const
+  {
+    Reader<SubChecked> reader(data, size);
+    reader.baseOffset = offset;
+    reader.materials = materials;
+    reader.materialCount = materialCount;
+
+    if constexpr(SubChecked==Checked)
+    {
+      reader.version = version;
+      reader.vertexFormat = vertexFormat;
+      reader.readLegacyMaterial = readLegacyMaterial;
+    }
+    else
+      reader.setVersion(version);
+
+    return reader;
+  }
+
+  //################################################################################################
+  //! Returns a copy of this reader at the same position, used to switch to unchecked reads.
+  template<bool OtherChecked>
+  Reader<OtherChecked> clone() const
+  {
+    Reader<OtherChecked> reader = subReader<OtherChecked>(pMin, size_t(pMax-pMin), baseOffset);
+    reader.p = p;
+    reader.meshTable = meshTable;
+    reader.stats = stats;
+    return reader;
+  }
+
+  //################################################################################################
+  [[noreturn]] void fail(const char* reason) const
+  {
+    throw ReadFailure(reason, baseOffset + size_t(p-pMin));
+  }
+
+  //################################################################################################
+  //! Returns the field of stats to pass to a ScopedTimer, or null if stats are not being collected.
+  double* timer(double ReadStats::* field) const
+  {
+    return stats?&(stats->*field):nullptr;
+  }
+
+  //################################################################################################
+  uint32_t readInt()
+  {
+    if constexpr(Checked)
+      if((pMax-p) < 4)
+        fail("BOJ readInt buffer overflow.");
+
+    uint32_t n;
+    memcpy(&n, p, 4);
+    p+=4;
+    return n;
+  }
+
+  //################################################################################################
+  float readFloat()
+  {
+    if constexpr(Checked)
+      if((pMax-p) < 4)
+        fail("BOJ readFloat buffer overflow.");
+
+    float n;
+    memcpy(&n, p, 4);
+    p+=4;
+    return n;
+  }
+
+  //################################################################################################
+  uint64_t readUInt64()
+  {
+    if constexpr(Checked)
+      if((pMax-p) < 8)
+        fail("BOJ readUInt64 buffer overflow.");
+
+    uint64_t n;
+    memcpy(&n, p, 8);
+    p+=8;
+    return n;
+  }
+
+  //################################################################################################
+  std::string readString()
+  {
+    size_t n = size_t(readInt());
+
+    // Check before allocating so that a corrupt length can't cause a huge allocation.
+    if constexpr(Checked)
+      if(size_t(pMax-p) < n)
+        fail("BOJ readString buffer overflow.");
+
+    std::string str(p, n);
+    p+=n;
+
+    return str;
+  }
+
+  //################################################################################################
+  //! Read the version and object count, returns false if the version is not supported.
+  bool readHeader(uint32_t& objCount)
+  {
+    objCount = readInt();
+    setVersion(0);
+
+    for(uint32_t v=maxVersion; v; v--)
+    {
+      if(objCount == (uint32_t(0)-v))
+      {
+        setVersion(v);
+        objCount = readInt();
+        break;
+      }
+    }
+
+    if(version==0)
+    {
+      uint32_t fileVersion = uint32_t(0)-objCount;
+      if(fileVersion<10000)
+      {
+        tpWarning() << "Failed to deserialize model, BOJ file version: " << fileVersion << " max supported version: " << maxVersion;
+        return false;
+      }
+    }
+
+    // Version 28+ a fixed size header gives the offset of each section.
+    uint64_t meshTableOffset=0;
+    uint64_t materialTableOffset=0;
+    if(version>27)
+    {
+      readUInt64(); // boundsSize
+      readUInt64(); // boundsOffset
+      meshTableOffset = readUInt64();
+      materialTableOffset = readUInt64();
+      readUInt64(); // materialTableSize
+      if(readInt()!=blockAlignment)
+        fail("BOJ unsupported alignment.");
+      if(readInt()!=((version>28)?32:16))
+        fail("BOJ unsupported mesh table entry size.");
+      readUInt64(); // Version 29+ bytes of replaced chunks, reserved in version 28.
+    }
+
+    // Version 26+ the bounds of each mesh, these are read by readBOJInfo.
+    else if(version>25)
+      skip(size_t(readUInt64()));
+
+    if(version>23)
+    {
+      if(version>27)
+        seek(materialTableOffset);
+
+      materialCount = size_t(readInt());
+
+      // Version 29+ the table gives the offset and size of each material so that they can be replaced
+      // in place, before that each material is at least a name, JSON string, and uvTransformation.
+      if(version>28)
+      {
+        readInt(); // Reserved.
+        if(size_t(pMax-p)/16 < materialCount)
+          fail("BOJ material table buffer overflow.");
+      }
+      else if(size_t(pMax-p)/(9*4) < materialCount)
+        fail("BOJ material table buffer overflow.");
+
+      // Each distinct material is only parsed once, if materialOffsets is set they are decoded later
+      // as they are needed.
+      std::shared_ptr<std::vector<tp_math_utils::Material>> materialTable;
+      if(materialOffsets)
+        materialOffsets->resize(materialCount);
+      else
+        materialTable = std::make_shared<std::vector<tp_math_utils::Material>>(materialCount);
+
+      for(size_t i=0; i<materialCount; i++)
+      {
+        Reader reader = (version>28)?chunkReader():*this;
+        reader.stats = stats;
+        if(materialOffsets)
+        {
+          materialOffsets->at(i) = reader.baseOffset - baseOffset + size_t(reader.p-reader.pMin);
+          reader.skipMaterial();
+        }
+        else
+          reader.readMaterial(materialTable->at(i));
+
+        if(version<29)
+          p = reader.p;
+      }
+      materials = materialTable;
+    }
+
+    if(version>20)
+    {
+      if(version>27)
+        seek(meshTableOffset);
+
+      size_t entrySize = (version>28)?32:16;
+      if(size_t(pMax-p)/entrySize < objCount)
+        fail("BOJ mesh table buffer overflow.");
+
+      uint64_t size = uint64_t(pMax-pMin);
+      meshTable.resize(objCount);
+      for(auto& range : meshTable)
+      {
+        range.offset = readUInt64();
+        range.size   = readUInt64();
+
+        if(range.offset>size || range.size>(size-range.offset))
+          fail("BOJ mesh table out of range.");
+
+        if(version>28)
+        {
+          range.metadataOffset = readUInt64();
+          range.metadataSize   = readUInt64();
+
+          if(range.metadataOffset>size || range.metadataSize>(size-range.metadataOffset))
+            fail("BOJ mesh table out of range.");
+        }
+      }
+    }
+
+    return true;
+  }
+
+  //################################################################################################
+  //! Version 25+ material state is stored as length prefixed CBOR.
+  nlohmann::json readCBOR()
+  {
+    size_t n = size_t(readInt());
+    if constexpr(Checked)
+      if(size_t(pMax-p) < n)
+        fail("BOJ readCBOR buffer overflow.");
+
+    // Like jsonFromString invalid data results in an empty state rather than failing the load.
+    nlohmann::json j = nlohmann::json::from_cbor(p, p+n, true, false);
+    p+=n;
+
+    if(j.is_discarded())
+      return nlohmann::json();
+
+    return j;
+  }
+
+  //################################################################################################
+  void skip(size_t n)
+  {
+    if constexpr(Checked)
+      if(size_t(pMax-p) < n)
+        fail("BOJ skip buffer overflow.");
+    p+=n;
+  }
+
+  //################################################################################################
+  //! Move to offset bytes from the start of the data.
+  void seek(uint64_t offset)
+  {
+    if(offset>uint64_t(pMax-pMin))
+      fail("BOJ seek out of range.");
+    p = pMin+size_t(offset);
+  }
+
+  //################################################################################################
+  //! Version 28+ skip the padding up to the next aligned offset.
+  void skipPadding()
+  {
+    if(version>27)
+      skip(paddingSize(size_t(p-pMin)));
+  }
+
+  //################################################################################################
+  //! The number of vertex records, version 28+ these are aligned so this skips the padding after it.
+  size_t readVertCount()
+  {
+    size_t vertCount = size_t(readInt());
+    skipPadding();
+    return vertCount;
+  }
+
+  //################################################################################################
+  void skipString()
+  {
+    skip(readInt());
+  }
+
+  //################################################################################################
+  //! Version 29+ read the offset and size of a chunk from a table and return a reader for it.
+  Reader chunkReader()
+  {
+    uint64_t offset = readUInt64();
+    uint64_t size = readUInt64();
+
+    uint64_t dataSize = uint64_t(pMax-pMin);
+    if(offset>dataSize || size>(dataSize-offset))
+      fail("BOJ chunk out of range.");
+
+    return subReader(pMin+size_t(offset), size_t(size), baseOffset+size_t(offset));
+  }
+
+  //################################################################################################
+  //! Version 29+ returns a reader for the material index and comments of the mesh.
+  Reader metadataReader() const
+  {
+    return subReader(metadata, metadataSize, metadataOffset);
+  }
+
+  //################################################################################################
+  //! Returns a reader for the block of mesh m, only valid for version 21+ files.
+  Reader meshReader(size_t m, ReadStats* meshStats) const
+  {
+    const auto& range = meshTable.at(m);
+    Reader reader = subReader(pMin+range.offset, size_t(range.size), baseOffset+size_t(range.offset));
+    reader.stats = meshStats;
+    reader.metadata = pMin+range.metadataOffset;
+    reader.metadataSize = size_t(range.metadataSize);
+    reader.metadataOffset = baseOffset+size_t(range.metadataOffset);
+    return reader;
+  }
+
+  //################################################################################################
+  //! Walk the structure of every mesh checking counts and lengths against the buffer.
+  /*!
+  Nothing is decoded or allocated, once this has passed the meshes can be read without checks.
+  meshIndex is set to the mesh being checked so that errors can be reported against it.
+  */
+  void validate(uint32_t objCount, size_t& meshIndex) const
+  {
+    if(meshTable.empty())
+    {
+      Reader reader = clone<Checked>();
+      for(meshIndex=0; meshIndex<objCount; meshIndex++)
+        reader.skipMeshData();
+    }
+    else
+    {
+      for(meshIndex=0; meshIndex<objCount; meshIndex++)
+        meshReader(meshIndex, nullptr).skipMeshData();
+    }
+
+    meshIndex = ReadError::noMesh;
+  }
+
+  //################################################################################################
+  //! Read mesh m, for version 21+ files this can be called for any mesh from any thread.
+  /*!
+  \returns false if the mesh was rejected by the filters in options, in which case it is skipped.
+  */
+  bool readMesh(size_t m, tp_math_utils::Geometry3D& mesh, const ReadOptions& options)
+  {
+    return readMesh(m, mesh, options, stats);
+  }
+
+  //################################################################################################
+  //! Read mesh m adding counts and timings to meshStats, this allows each thread to use its own.
+  bool readMesh(size_t m, tp_math_utils::Geometry3D& mesh, const ReadOptions& options, ReadStats* meshStats)
+  {
+    return readMesh(m, mesh, options, meshStats, [](auto& reader, tp_math_utils::Geometry3D& mesh)
+    {
+      reader.readVerts(mesh);
+      reader.readIndexes(mesh);
+    });
+  }
+
+  //################################################################################################
+  //! Read mesh m into render ready buffers.
+  bool readRenderMesh(size_t m, RenderMesh& mesh, const ReadOptions& options, const RenderReadOptions& renderOptions, ReadStats* meshStats)
+  {
+    mesh.meshIndex = m;
+    return readMesh(m, mesh, options, meshStats, [&](auto& reader, RenderMesh& mesh)
+    {
+      reader.readRenderGeometry(mesh, renderOptions);
+    });
+  }
+
+  //################################################################################################
+  //! Read mesh m using readGeometry(reader, mesh) to read the vertices and indexes.
+  template<typename Mesh, typename ReadGeometry>
+  bool readMesh(size_t m, Mesh& mesh, const ReadOptions& options, ReadStats* meshStats, const ReadGeometry& readGeometry)
+  {
+    if(options.meshIndexFilter && !callCallback(options.meshIndexFilter, m))
+    {
+      // With a mesh table there is no need to touch rejected meshes at all.
+      if(meshTable.empty())
+        skipMeshData();
+      return false;
+    }
+
+    if(meshTable.empty())
+      return readMeshData(mesh, options, readGeometry);
+
+    return meshReader(m, meshStats).readMeshData(mesh, options, readGeometry);
+  }
+
+  //################################################################################################
+  template<typename Mesh, typename ReadGeometry>
+  bool readMeshData(Mesh& mesh, const ReadOptions& options, const ReadGeometry& readGeometry)
+  {
+    // Version 29+ the material index and comments are in their own chunk, before that they are at
+    // the start of the mesh block.
+    Reader metadataChunk = (version>28)?metadataReader():Reader(nullptr, 0);
+    Reader& header = (version>28)?metadataChunk:*this;
+
+    const tp_math_utils::Material* material=nullptr;
+    if(version>23)
+    {
+      // Version 24+ meshes start with the index of their material in the material table, version
+      // 24+ files always have a mesh table so rejected meshes do not need to be skipped.
+      material = &materials->at(header.readInt());
+      if(options.materialFilter && !callCallback(options.materialFilter, material->name))
+        return false;
+    }
+    else if(options.materialFilter)
+    {
+      // The material name comes after the geometry, peek at it by seeking past the geometry.
+      const char* start = p;
+      skipGeometry();
+      tp_utils::StringID materialName = readString();
+      p = start;
+
+      if(!callCallback(options.materialFilter, materialName))
+      {
+        skipMeshData();
+        return false;
+      }
+    }
+
+    mesh.comments.resize(size_t(header.readInt()));
+    for(auto& comment : mesh.comments)
+      comment = header.readString();
+
+    if(version>26)
+      seekLOD(options.lod);
+
+    if(options.loadGeometry)
+      readGeometry(*this, mesh);
+    else
+    {
+      skipVerts();
+      skipIndexes();
+    }
+
+    if(material)
+      mesh.material = *material;
+    else
+      readMaterial(mesh.material);
+
+    if(stats)
+    {
+      stats->meshes++;
+      addGeometryStats(*stats, mesh);
+    }
+
+    return true;
+  }
+
+  //################################################################################################
+  void skipMeshData()
+  {
+    if(version>28)
+    {
+      Reader metadataChunk = metadataReader();
+      if(metadataChunk.readInt() >= materialCount)
+        metadataChunk.fail("BOJ material index out of range.");
+      for(uint32_t c=metadataChunk.readInt(); c; c--)
+        metadataChunk.skipString();
+      skipLODs();
+    }
+    else if(version>23)
+    {
+      if(readInt() >= materialCount)
+        fail("BOJ material index out of range.");
+      skipGeometry();
+    }
+    else
+    {
+      skipGeometry();
+      skipMaterial();
+    }
+  }
+
+  //################################################################################################
+  void skipGeometry()
+  {
+    for(uint32_t c=readInt(); c; c--)
+      skipString();
+
+    if(version>26)
+    {
+      skipLODs();
+      return;
+    }
+
+    skipVerts();
+    skipIndexes();
+  }
+
+  //################################################################################################
+  //! Version 27+ skip every level of detail checking that each is the size given in the LOD table.
+  void skipLODs()
+  {
+    size_t lodCount = size_t(readInt());
+    if(lodCount==0)
+      fail("BOJ mesh has no LODs.");
+
+    if constexpr(Checked)
+      if(size_t(pMax-p)/8 < lodCount)
+        fail("BOJ LOD table buffer overflow.");
+
+    const char* table = p;
+    p+=lodCount*8;
+    skipPadding();
+
+    for(size_t l=0; l<lodCount; l++)
+    {
+      uint64_t lodSize;
+      memcpy(&lodSize, table+l*8, 8);
+
+      const char* start = p;
+      skipVerts();
+      skipIndexes();
+      skipPadding();
+      if(uint64_t(p-start) != lodSize)
+        fail("BOJ LOD size mismatch.");
+    }
+  }
+
+  //################################################################################################
+  //! Version 27+ move to the start of a level of detail, or the coarsest if there are fewer levels.
+  void seekLOD(size_t lod)
+  {
+    size_t lodCount = size_t(readInt());
+    size_t level = std::min(lod, lodCount-1);
+
+    uint64_t offset=0;
+    for(size_t l=0; l<level; l++)
+      offset += readUInt64();
+
+    skip((lodCount-level)*8);
+    skipPadding();
+    skip(size_t(offset));
+  }
+
+  //################################################################################################
+  //! The number of levels of detail stored for mesh m, files before version 27 only have one.
+  size_t lodCount(size_t m) const
+  {
+    if(version<27)
+      return 1;
+
+    Reader reader = meshReader(m, nullptr);
+    if(version<29)
+    {
+      reader.readInt(); // materialIndex
+      for(uint32_t c=reader.readInt(); c; c--)
+        reader.skipString();
+    }
+    return size_t(reader.readInt());
+  }
+
+  //################################################################################################
+  //! Version 22+ vertex and index sections are wrapped in a chunk that may be compressed.
+  template<typename ReadSection>
+  void readChunk(const ReadSection& readSection)
+  {
+    if(version<22 || readInt()==0)
+    {
+      readSection(*this);
+      return;
+    }
+
+    uint64_t rawSize = readUInt64();
+    uint64_t compressedSize = readUInt64();
+    if constexpr(Checked)
+      if(compressedSize>uint64_t(pMax-p))
+        fail("BOJ readChunk buffer overflow.");
+
+    // Each compressed byte can produce at most 255 bytes, reject sizes that could not be valid.
+    if(rawSize/255 > compressedSize)
+      fail("BOJ readChunk invalid size.");
+
+    std::string raw;
+    raw.resize(size_t(rawSize));
+    if(!decompressChunk(p, size_t(compressedSize), raw.data(), raw.size()))
+      fail("BOJ readChunk failed to decompress.");
+
+    // The decompressed data has not been validated so it is always read with checks, errors are
+    // reported at the offset of the chunk.
+    size_t offset = baseOffset + size_t(p-pMin);
+    p+=compressedSize;
+
+    try
+    {
+      auto reader = subReader<true>(raw.data(), raw.size(), offset);
+      readSection(reader);
+    }
+    catch(const ReadFailure& e)
+    {
+      throw ReadFailure(e.what(), offset);
+    }
+  }
+
+  //################################################################################################
+  template<typename SkipSection>
+  void skipChunk(const SkipSection& skipSection)
+  {
+    if(version<22 || readInt()==0)
+    {
+      skipSection(*this);
+      return;
+    }
+
+    readUInt64(); // rawSize
+    skip(size_t(readUInt64()));
+  }
+
+  //################################################################################################
+  void readVerts(tp_math_utils::Geometry3D& mesh)
+  {
+    ScopedTimer timer(this->timer(&ReadStats::vertsSeconds));
+    readChunk([&](auto& reader){reader.readVertsData(mesh);});
+  }
+
+  //################################################################################################
+  void readIndexes(tp_math_utils::Geometry3D& mesh)
+  {
+    ScopedTimer timer(this->timer(&ReadStats::indexesSeconds));
+    readChunk([&](auto& reader){reader.readIndexesData(mesh);});
+  }
+
+  //################################################################################################
+  void readRenderGeometry(RenderMesh& mesh, const RenderReadOptions& renderOptions)
+  {
+    {
+      ScopedTimer timer(this->timer(&ReadStats::vertsSeconds));
+      readChunk([&](auto& reader){reader.readRenderVertsData(mesh, renderOptions);});
+    }
+
+    {
+      ScopedTimer timer(this->timer(&ReadStats::indexesSeconds));
+      readChunk([&](auto& reader){reader.readRenderIndexesData(mesh, renderOptions);});
+    }
+  }
+
+  //################################################################################################
+  void skipVerts()
+  {
+    skipChunk([](auto& reader){reader.skipVertsData();});
+  }
+
+  //################################################################################################
+  void skipIndexes()
+  {
+    skipChunk([](auto& reader){reader.skipIndexesData();});
+  }
+
+  //################################################################################################
+  void skipVertsData()
+  {
+    size_t vertCount = readVertCount();
+    if constexpr(Checked)
+      if(size_t(pMax-p)/vertexFormat.recordSize < vertCount)
+        fail("BOJ skipVerts buffer overflow.");
+    p+=vertCount*vertexFormat.recordSize;
+  }
+
+  //################################################################################################
+  void skipIndexesData()
+  {
+    if(version>22)
+    {
+      if(readInt()!=0)
+      {
+        readInt(); // encoding
+        uint64_t tableSize = readUInt64();
+        uint64_t payloadSize = readUInt64();
+        skip(size_t(tableSize));
+        skip(size_t(payloadSize));
+      }
+      return;
+    }
+
+    for(uint32_t c=readInt(); c; c--)
+    {
+      readInt(); // type
+      size_t indexCount = size_t(readInt());
+      if constexpr(Checked)
+        if(size_t(pMax-p)/sizeof(uint32_t) < indexCount)
+          fail("BOJ skipIndexes buffer overflow.");
+      p+=indexCount*sizeof(uint32_t);
+    }
+  }
+
+  //################################################################################################
+  void skipMaterial()
+  {
+    if(version<20)
+    {
+      LegacyMaterialLayout layout = legacyMaterialLayout(version);
+      skipString(); // name
+      skip(layout.numericBytes);
+      for(size_t i=0; i<layout.strings; i++)
+        skipString();
+    }
+    else
+    {
+      skipString(); // name
+      skipString(); // material JSON or CBOR
+      skip(7*sizeof(float)); // uvTransformation
+    }
+  }
+
+  //################################################################################################
+  void readVertsData(tp_math_utils::Geometry3D& mesh)
+  {
+    // Fixed size vertex records, check the size once and decode the whole block.
+    size_t vertCount = readVertCount();
+    if constexpr(Checked)
+      if(size_t(pMax-p)/vertexFormat.recordSize < vertCount)
+        fail("BOJ readVerts buffer overflow.");
+
+    mesh.verts.resize(vertCount);
+    vertexFormat.decode(p, mesh.verts.data(), vertCount);
+    p+=vertCount*vertexFormat.recordSize;
+  }
+
+  //################################################################################################
+  //! Decode the vertex records straight into the render buffers.
+  void readRenderVertsData(RenderMesh& mesh, const RenderReadOptions& renderOptions)
+  {
+    size_t vertCount = readVertCount();
+    if constexpr(Checked)
+      if(size_t(pMax-p)/vertexFormat.recordSize < vertCount)
+        fail("BOJ readVerts buffer overflow.");
+
+    mesh.vertexCount = vertCount;
+    bool interleaved = renderOptions.vertexLayout==RenderVertexLayout::Interleaved;
+
+    RenderVertexBuffers buffers;
+    if(renderOptions.allocateVertices)
+      buffers = callCallback(renderOptions.allocateVertices, mesh);
+    else if(interleaved)
+    {
+      mesh.interleaved.resize(vertCount*8);
+      buffers.interleaved = mesh.interleaved.data();
+    }
+    else
+    {
+      mesh.positions.resize(vertCount*3);
+      mesh.textures.resize(vertCount*2);
+      mesh.normals.resize(vertCount*3);
+      buffers.positions = mesh.positions.data();
+      buffers.textures = mesh.textures.data();
+      buffers.normals = mesh.normals.data();
+    }
+
+    if(vertCount)
+    {
+      if(interleaved)
+      {
+        if(!buffers.interleaved)
+          throw std::logic_error("BOJ allocateVertices returned null.");
+        vertexFormat.decodeInterleaved(p, buffers.interleaved, vertCount);
+      }
+      else
+      {
+        if(!buffers.positions || !buffers.textures || !buffers.normals)
+          throw std::logic_error("BOJ allocateVertices returned null.");
+        vertexFormat.decodeSoA(p, buffers, vertCount);
+      }
+    }
+
+    p+=vertCount*vertexFormat.recordSize;
+  }
+
+  //################################################################################################
+  //! Decode the index arrays straight into a single triangle list in the render buffer.
+  /*!
+  The type and length of each array are read first to size the buffer, then each array is decoded
+  and flattened into it. Every index is checked against the vertex count before it is written, even
+  by an unchecked reader, because validate does not decode the indexes.
+  */
+  void readRenderIndexesData(RenderMesh& mesh, const RenderReadOptions& renderOptions)
+  {
+    struct IndexArray
+    {
+      uint32_t type;
+      size_t count;
+      const uint8_t* data; //!< Null for delta encoded arrays, these are decoded in order.
+    };
+
+    std::vector<IndexArray> arrays;
+    uint32_t width=4;
+    bool delta=false;
+    const uint8_t* payload=nullptr;
+    const uint8_t* payloadMax=nullptr;
+
+    if(version>22)
+    {
+      size_t count = size_t(readInt());
+
+      // Each index array has at least one byte in the table.
+      if(size_t(pMax-p) < count)
+        fail("BOJ readPackedIndexes buffer overflow.");
+
+      if(count!=0)
+      {
+        uint32_t encoding = readInt();
+        width = encoding&0xFF;
+        delta = encoding&0x100;
+        if(width!=1 && width!=2 && width!=4)
+          fail("BOJ readPackedIndexes invalid width.");
+
+        uint64_t tableSize = readUInt64();
+        uint64_t payloadSize = readUInt64();
+        if(tableSize<count || tableSize>uint64_t(pMax-p) || payloadSize>uint64_t(pMax-p)-tableSize)
+          fail("BOJ readPackedIndexes buffer overflow.");
+
+        auto table = reinterpret_cast<const uint8_t*>(p);
+        auto lengths = table+count;
+        auto tableMax = table+tableSize;
+        payload = tableMax;
+        payloadMax = payload+payloadSize;
+        p+=tableSize+payloadSize;
+
+        // Every delta takes at least one byte and every narrow index takes width bytes.
+        uint64_t available = delta?payloadSize:payloadSize/width;
+        const uint8_t* data = payload;
+        arrays.resize(count);
+        for(size_t c=0; c<count; c++)
+        {
+          uint64_t indexCount=0;
+          if(!readVarint(lengths, tableMax, indexCount))
+            fail("BOJ readPackedIndexes invalid length.");
+          if(indexCount>available)
+            fail("BOJ readPackedIndexes buffer overflow.");
+          available-=indexCount;
+
+          arrays[c] = {table[c], size_t(indexCount), delta?nullptr:data};
+          if(!delta)
+            data+=indexCount*width;
+        }
+      }
+    }
+    else
+    {
+      size_t count = size_t(readInt());
+      if constexpr(Checked)
+        if(size_t(pMax-p)/(2*sizeof(uint32_t)) < count)
+          fail("BOJ readIndexes buffer overflow.");
+
+      arrays.resize(count);
+      for(auto& array : arrays)
+      {
+        array.type = readInt();
+        array.count = size_t(readInt());
+        if constexpr(Checked)
+          if(size_t(pMax-p)/sizeof(uint32_t) < array.count)
+            fail("BOJ readIndexes buffer overflow.");
+        array.data = reinterpret_cast<const uint8_t*>(p);
+        p+=array.count*sizeof(uint32_t);
+      }
+    }
+
+    mesh.indexCount=0;
+    for(const auto& array : arrays)
+      mesh.indexCount += flattenedIndexCount(array.type, array.count);
+    mesh.indexSize = (renderOptions.allow16BitIndexes && mesh.vertexCount<=65536)?2:4;
+
+    void* indexes=nullptr;
+    if(renderOptions.allocateIndexes)
+      indexes = callCallback(renderOptions.allocateIndexes, mesh);
+    else if(mesh.indexSize==2)
+    {
+      mesh.indexes16.resize(mesh.indexCount);
+      indexes = mesh.indexes16.data();
+    }
+    else
+    {
+      mesh.indexes32.resize(mesh.indexCount);
+      indexes = mesh.indexes32.data();
+    }
+
+    if(mesh.indexCount==0)
+      return;
+
+    if(!indexes)
+      throw std::logic_error("BOJ allocateIndexes returned null.");
+
+    if(mesh.indexSize==2)
+      flattenIndexArrays(arrays, width, payload, payloadMax, mesh.vertexCount, static_cast<uint16_t*>(indexes));
+    else
+      flattenIndexArrays(arrays, width, payload, payloadMax, mesh.vertexCount, static_cast<uint32_t*>(indexes));
+  }
+
+  //################################################################################################
+  //! Decode each of the arrays found by readRenderIndexesData into dst, see flattenIndexArray.
+  template<typename IndexArrays, typename T>
+  void flattenIndexArrays(const IndexArrays& arrays, uint32_t width, const uint8_t* payload, const uint8_t* payloadMax, size_t vertexCount, T* dst)
+  {
+    auto checked = [&](uint32_t i)
+    {
+      if(i>=vertexCount)
+        fail("BOJ index out of range.");
+      return i;
+    };
+
+    uint32_t previous=0;
+    for(const auto& array : arrays)
+    {
+      const uint8_t* src = array.data;
+      if(!src)
+      {
+        dst = flattenIndexArray(array.type, array.count, [&]
+        {
+          uint64_t z=0;
+          if(!readVarint(payload, payloadMax, z))
+            fail("BOJ readPackedIndexes invalid delta.");
+          previous += uint32_t(z>>1) ^ (uint32_t(0)-uint32_t(z&1));
+          return checked(previous);
+        }, dst);
+        continue;
+      }
+
+      if(width==1)
+        dst = flattenIndexArray(array.type, array.count, [&]{return checked(loadIndex<uint8_t>(src));}, dst);
+      else if(width==2)
+        dst = flattenIndexArray(array.type, array.count, [&]{return checked(loadIndex<uint16_t>(src));}, dst);
+      else
+        dst = flattenIndexArray(array.type, array.count, [&]{return checked(loadIndex<uint32_t>(src));}, dst);
+    }
+  }
+
+  //################################################################################################
+  void readIndexesData(tp_math_utils::Geometry3D& mesh)
+  {
+    if(version>22)
+    {
+      readPackedIndexes(mesh);
+      return;
+    }
+
+    mesh.indexes.resize(size_t(readInt()));
+    for(auto& index : mesh.indexes)
+    {
+      switch(readInt())
+      {
+        case 1:  index.type = mesh.triangleFan;   break;
+        case 2:  index.type = mesh.triangleStrip; break;
+        default: index.type = mesh.triangles;     break;
+      }
+
+      // Indexes are stored as uint32_t, copy the whole block straight into the int array.
+      size_t indexCount = size_t(readInt());
+      if constexpr(Checked)
+        if(size_t(pMax-p)/sizeof(uint32_t) < indexCount)
+          fail("BOJ readIndexes buffer overflow.");
+
+      index.indexes.resize(indexCount);
+      if(indexCount)
+        memcpy(index.indexes.data(), p, indexCount*sizeof(uint32_t));
+      p+=indexCount*sizeof(uint32_t);
+    }
+  }
+
+  //################################################################################################
+  //! Version 23+ a type and length table followed by narrow or delta encoded indexes.
+  void readPackedIndexes(tp_math_utils::Geometry3D& mesh)
+  {
+    size_t count = size_t(readInt());
+
+    // Each index array has at least one byte in the table.
+    if(size_t(pMax-p) < count)
+      fail("BOJ readPackedIndexes buffer overflow.");
+
+    mesh.indexes.resize(count);
+    if(count==0)
+      return;
+
+    uint32_t encoding = readInt();
+    uint32_t width = encoding&0xFF;
+    bool delta = encoding&0x100;
+    if(width!=1 && width!=2 && width!=4)
+      fail("BOJ readPackedIndexes invalid width.");
+
+    uint64_t tableSize = readUInt64();
+    uint64_t payloadSize = readUInt64();
+    if(tableSize<count || tableSize>uint64_t(pMax-p) || payloadSize>uint64_t(pMax-p)-tableSize)
+      fail("BOJ readPackedIndexes buffer overflow.");
+
+    auto table = reinterpret_cast<const uint8_t*>(p);
+    auto lengths = table+count;
+    auto tableMax = table+tableSize;
+    auto payload = tableMax;
+    auto payloadMax = payload+payloadSize;
+    p+=tableSize+payloadSize;
+
+    uint32_t previous=0;
+    for(size_t c=0; c<count; c++)
+    {
+      auto& index = mesh.indexes[c];
+      switch(table[c])
+      {
+        case 1:  index.type = mesh.triangleFan;   break;
+        case 2:  index.type = mesh.triangleStrip; break;
+        default: index.type = mesh.triangles;     break;
+      }
+
+      uint64_t indexCount=0;
+      if(!readVarint(lengths, tableMax, indexCount))
+        fail("BOJ readPackedIndexes invalid length.");
+
+      if(delta)
+      {
+        // Every delta takes at least one byte.
+        if(indexCount>uint64_t(payloadMax-payload))
+          fail("BOJ readPackedIndexes buffer overflow.");
+
+        index.indexes.resize(size_t(indexCount));
+        for(int& i : index.indexes)
+        {
+          uint64_t z=0;
+          if(!readVarint(payload, payloadMax, z))
+            fail("BOJ readPackedIndexes invalid delta.");
+          previous += uint32_t(z>>1) ^ (uint32_t(0)-uint32_t(z&1));
+          i = int(previous);
+        }
+      }
+      else
+      {
+        if(indexCount>uint64_t(payloadMax-payload)/width)
+          fail("BOJ readPackedIndexes buffer overflow.");
+
+        index.indexes.resize(size_t(indexCount));
+        switch(width)
+        {
+          case 1:  widenIndexes<uint8_t >(payload, index.indexes.data(), index.indexes.size()); break;
+          case 2:  widenIndexes<uint16_t>(payload, index.indexes.data(), index.indexes.size()); break;
+          default: widenIndexes<uint32_t>(payload, index.indexes.data(), index.indexes.size()); break;
+        }
+        payload+=indexCount*width;
+      }
+    }
+  }
+
+  //################################################################################################
+  void readMaterial(tp_math_utils::Material& material)
+  {
+    ScopedTimer timer(this->timer(&ReadStats::materialsSeconds));
+    if(stats)
+      stats->materials++;
+
+    material.name = readString();
+
+    if(version<20)
+    {
+      (this->*readLegacyMaterial)(material);
+    }
+    else
+    {
+      // Version 20+
+      if(version>24)
+        material.loadState(readCBOR());
+      else
+        material.loadState(tp_utils::jsonFromString(readString()));
+
+      material.uvTransformation.skewUV.x      = readFloat();
+      material.uvTransformation.skewUV.y      = readFloat();
+      material.uvTransformation.scaleUV.x     = readFloat();
+      material.uvTransformation.scaleUV.y     = readFloat();
+      material.uvTransformation.translateUV.x = readFloat();
+      material.uvTransformation.translateUV.y = readFloat();
+      material.uvTransformation.rotateUV      = readFloat();
+    }
+  }
+
+  //################################################################################################
+  //! Read a version 0-19 material after its name, instantiated for each version.
+  template<uint32_t Version>
+  void readLegacyMaterialVersion(tp_math_utils::Material& material)
+  {
+    auto openGLMaterial = material.findOrAddOpenGL();
+    auto legacyMaterial = material.findOrAddLegacy();
+
+    if constexpr(Version>16)
+    {
+      legacyMaterial->shaderType = tp_math_utils::ShaderType(readInt());
+    }
+
+    openGLMaterial->albedo.x = readFloat();
+    openGLMaterial->albedo.y = readFloat();
+    openGLMaterial->albedo.z = readFloat();
+
+    if constexpr(Version<3)
+    {
+      openGLMaterial->albedo.x = readFloat();
+      openGLMaterial->albedo.y = readFloat();
+      openGLMaterial->albedo.z = readFloat();
+    }
+
+    if constexpr(Version<6)
+    {
+      readFloat(); // specular
+      readFloat(); // specular
+      readFloat(); // specular
+    }
+
+    if constexpr(Version<3)
+      readFloat();
+
+    openGLMaterial->alpha = readFloat();
+
+    if constexpr(Version>2)
+    {
+      openGLMaterial->roughness       = readFloat();
+      openGLMaterial->metalness       = readFloat();
+
+      if constexpr(Version>4)
+      {
+        openGLMaterial->transmission  = readFloat();
+        if constexpr(Version>7)
+          openGLMaterial->transmissionRoughness  = readFloat();
+
+        legacyMaterial->ior           = readFloat();
+
+        if constexpr(Version>6)
+        {
+          legacyMaterial->sheen              = readFloat();
+          legacyMaterial->sheenTint          = readFloat();
+          legacyMaterial->clearCoat          = readFloat();
+          legacyMaterial->clearCoatRoughness = readFloat();
+
+          if constexpr(Version>9)
+          {
+            legacyMaterial->   iridescentFactor = readFloat();
+            legacyMaterial->   iridescentOffset = readFloat();
+            legacyMaterial->iridescentFrequency = readFloat();
+
+            if constexpr(Version>10)
+            {
+              legacyMaterial->  specular        = readFloat();
+            }
+          }
+        }
+
+        legacyMaterial->sssScale      = readFloat();
+
+        legacyMaterial->sssRadius.x   = readFloat();
+        legacyMaterial->sssRadius.y   = readFloat();
+        legacyMaterial->sssRadius.z   = readFloat();
+
+        if constexpr(Version>11)
+        {
+          if constexpr(Version>15)
+          {
+            legacyMaterial->sssMethod = tp_math_utils::SSSMethod(readInt());
+            legacyMaterial->normalStrength = readFloat();
+          }
+
+          openGLMaterial->albedoBrightness = readFloat();
+          openGLMaterial->albedoContrast   = readFloat();
+          openGLMaterial->albedoGamma      = readFloat();
+          openGLMaterial->albedoHue        = readFloat();
+          openGLMaterial->albedoSaturation = readFloat();
+          openGLMaterial->albedoValue      = readFloat();
+          openGLMaterial->albedoFactor     = readFloat();
+        }
+
+        legacyMaterial->sss.x         = readFloat();
+        legacyMaterial->sss.y         = readFloat();
+        legacyMaterial->sss.z         = readFloat();
+
+        legacyMaterial->emission.x    = readFloat();
+        legacyMaterial->emission.y    = readFloat();
+        legacyMaterial->emission.z    = readFloat();
+
+        legacyMaterial->emissionScale = readFloat();
+
+        if constexpr(Version>6)
+        {
+          legacyMaterial->velvet.x    = readFloat();
+          legacyMaterial->velvet.y    = readFloat();
+          legacyMaterial->velvet.z    = readFloat();
+
+          legacyMaterial->velvetScale = readFloat();
+        }
+
+        if constexpr(Version>5)
+        {
+          legacyMaterial->heightScale    = readFloat();
+          legacyMaterial->heightMidlevel = readFloat();
+        }
+      }
+
+      openGLMaterial->useAmbient     = readFloat();
+      openGLMaterial->useDiffuse     = readFloat();
+      openGLMaterial->useNdotL       = readFloat();
+      openGLMaterial->useAttenuation = readFloat();
+      openGLMaterial->useShadow      = readFloat();
+      openGLMaterial->useLightMask   = readFloat();
+      openGLMaterial->useReflection  = readFloat();
+    }
+
+
+    if constexpr(Version>0)
+    {
+      if constexpr(Version<3)
+        readFloat();
+
+      openGLMaterial->albedoScale   = readFloat();
+      if constexpr(Version<6)
+        readFloat(); //specularScale
+    }
+
+    if constexpr(Version>1)
+    {
+      openGLMaterial->tileTextures = readInt();
+
+      if constexpr(Version>12)
+      {
+        material.uvTransformation.skewUV.x      = readFloat();
+        material.uvTransformation.skewUV.y      = readFloat();
+        material.uvTransformation.scaleUV.x     = readFloat();
+        material.uvTransformation.scaleUV.y     = readFloat();
+        material.uvTransformation.translateUV.x = readFloat();
+        material.uvTransformation.translateUV.y = readFloat();
+        material.uvTransformation.rotateUV      = readFloat();
+
+        if constexpr(Version>13)
+        {
+          legacyMaterial->rayVisibilityCamera       = readInt();
+          legacyMaterial->rayVisibilityDiffuse      = readInt();
+          legacyMaterial->rayVisibilityGlossy       = readInt();
+          legacyMaterial->rayVisibilityTransmission = readInt();
+          legacyMaterial->rayVisibilityScatter      = readInt();
+          legacyMaterial->rayVisibilityShadow       = readInt();
+
+          if constexpr(Version>14)
+            openGLMaterial->rayVisibilityShadowCatcher = readInt();
+        }
+      }
+    }
+
+    if constexpr(Version<3)
+      readString();
+
+    openGLMaterial->albedoTexture  = readString();
+    if constexpr(Version<6)
+      readString(); //specularTexture
+    openGLMaterial->alphaTexture    = readString();
+    openGLMaterial->normalsTexture  = readString();
+
+    if constexpr(Version>2)
+    {
+      openGLMaterial->roughnessTexture = readString();
+      openGLMaterial->metalnessTexture = readString();
+      if constexpr(Version<6)
+        readString(); //aoTexture
+      else
+      {
+        legacyMaterial->emissionTexture = readString();
+        legacyMaterial->     sssTexture = readString();
+        legacyMaterial->  heightTexture = readString();
+        if constexpr(Version>6)
+        {
+          openGLMaterial->         transmissionTexture = readString();
+          openGLMaterial->transmissionRoughnessTexture = readString();
+          legacyMaterial->                sheenTexture = readString();
+          legacyMaterial->            sheenTintTexture = readString();
+          legacyMaterial->            clearCoatTexture = readString();
+          legacyMaterial->   clearCoatRoughnessTexture = readString();
+          legacyMaterial->               velvetTexture = readString();
+          legacyMaterial->         velvetFactorTexture = readString();
+
+          if constexpr(Version>8)
+          {
+            legacyMaterial->           sssScaleTexture = readString();
+            legacyMaterial->   iridescentFactorTexture = readString();
+            legacyMaterial->   iridescentOffsetTexture = readString();
+            legacyMaterial->iridescentFrequencyTexture = readString();
+
+            if constexpr(Version>10)
+            {
+              legacyMaterial->         specularTexture = readString();
+
+              if constexpr(Version>18)
+              {
+                openGLMaterial->           rgbaTexture = readString();
+                openGLMaterial->          rmttrTexture = readString();
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  //################################################################################################
+  template<size_t... Versions>
+  static constexpr std::array<LegacyMaterialReader, sizeof...(Versions)> makeLegacyMaterialReaders(std::index_sequence<Versions...>)
+  {
+    return {&Reader::template readLegacyMaterialVersion<uint32_t(Versions)>...};
+  }
+
+  //################################################################################################
+  //! A reader for each legacy version indexed by version.
+  static const std::array<LegacyMaterialReader, 20>& legacyMaterialReaders()
+  {
+    static constexpr std::array<LegacyMaterialReader, 20> readers = makeLegacyMaterialReaders(std::make_index_sequence<20>());
+    return readers;
+  }
+};
+
+}
+
+#endif
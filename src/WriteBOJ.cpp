@@ -1,33 +1,948 @@
 #include "tp_boj/WriteBOJ.h"
+#include "tp_boj/Compression.h"
+#include "tp_boj/BOJInfo.h"
 
 #include "tp_utils/FileUtils.h"
+#include "tp_utils/DebugUtils.h"
+
+#include "WriteBOJPrivate.h"
 
 #include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <type_traits>
 
 namespace tp_boj
 {
 
+namespace
+{
+//##################################################################################################
+size_t varintSize(uint64_t n)
+{
+  size_t size=1;
+  for(; n>=0x80; n>>=7)
+    size++;
+  return size;
+}
+
+//##################################################################################################
+uint8_t* addVarint(uint8_t* data, uint64_t n)
+{
+  for(; n>=0x80; n>>=7)
+    *(data++) = uint8_t(n|0x80);
+  *(data++) = uint8_t(n);
+  return data;
+}
+
+//##################################################################################################
+uint64_t zigZag(int64_t n)
+{
+  return (uint64_t(n)<<1) ^ uint64_t(n>>63);
+}
+
+//##################################################################################################
+//! How the index section of a version 23+ mesh is packed.
+/*!
+All of the index arrays of a mesh are packed into a single block, a table of types and lengths
+followed by the indexes either at the narrowest width that fits or as zig-zag varint deltas.
+*/
+struct IndexEncoding
+{
+  uint32_t width{4};
+  bool delta{false};
+  uint64_t tableSize{0};
+  uint64_t payloadSize{0};
+};
+
+//##################################################################################################
+IndexEncoding calculateIndexEncoding(const tp_math_utils::Geometry3D& mesh, bool allowDelta)
+{
+  IndexEncoding encoding;
+
+  uint32_t maxIndex=0;
+  uint64_t indexCount=0;
+  uint64_t deltaSize=0;
+  uint32_t previous=0;
+  for(const auto& index : mesh.indexes)
+  {
+    encoding.tableSize += 1 + varintSize(index.indexes.size());
+    indexCount += index.indexes.size();
+
+    for(int i : index.indexes)
+    {
+      maxIndex = std::max(maxIndex, uint32_t(i));
+
+      if(allowDelta)
+      {
+        deltaSize += varintSize(zigZag(int64_t(uint32_t(i)) - int64_t(previous)));
+        previous = uint32_t(i);
+      }
+    }
+  }
+
+  encoding.width = (maxIndex<=0xFF)?1:((maxIndex<=0xFFFF)?2:4);
+  encoding.payloadSize = indexCount*encoding.width;
+
+  if(allowDelta && deltaSize<encoding.payloadSize)
+  {
+    encoding.delta = true;
+    encoding.payloadSize = deltaSize;
+  }
+
+  return encoding;
+}
+
+//##################################################################################################
+//! A compressed vertex or index chunk, compressedSize is 0 if the chunk is stored raw.
+/*!
+The streaming writer sizes every mesh without keeping data, then encodes each mesh again just
+before it is written, see encodeWindow. This keeps memory use flat at the cost of compressing twice.
+*/
+struct CompressedChunk
+{
+  uint64_t rawSize{0};
+  uint64_t compressedSize{0};
+  std::string data;
+};
+
+//##################################################################################################
+//! Encoding state for the vertices and indexes of one level of detail.
+struct EncodedGeometry
+{
+  const tp_math_utils::Geometry3D* mesh{nullptr};
+  IndexEncoding indexEncoding;
+  CompressedChunk verts;
+  CompressedChunk indexes;
+  uint64_t size{0};
+};
+
+//##################################################################################################
+//! Per mesh encoding state that is needed by both the sizing and writing passes.
+struct EncodedMesh
+{
+  uint32_t materialIndex{0};
+  uint64_t geometrySize{0};
+  uint64_t metadataSize{0};
+
+  //! Counts for WriteStats, these are kept when the mesh is released.
+  size_t verts{0};
+  size_t indexes{0};
+  size_t lodCount{0};
+
+  //! A copy of the mesh if it is optimized.
+  tp_math_utils::Geometry3D optimizedMesh;
+
+  //! Generated LODs, or copies of the supplied LODs if they are optimized.
+  std::vector<tp_math_utils::Geometry3D> ownedLODs;
+
+  //! The mesh itself followed by progressively coarser LODs.
+  std::vector<EncodedGeometry> lods;
+
+  //################################################################################################
+  //! Free everything but the sizes, the streaming writer encodes the mesh again to write it.
+  void release()
+  {
+    optimizedMesh = tp_math_utils::Geometry3D();
+    ownedLODs = std::vector<tp_math_utils::Geometry3D>();
+    lods = std::vector<EncodedGeometry>();
+  }
+};
+
+//##################################################################################################
+template<typename Writer>
+void writeVerts(Writer& writer, const tp_math_utils::Geometry3D& mesh)
+{
+  writer.addInt(uint32_t(mesh.verts.size()));
+
+  // Version 28+ the vertex records are aligned.
+  writer.addPadding();
+
+  for(const auto& vert : mesh.verts)
+  {
+    writer.addFloat(vert.vert.x);
+    writer.addFloat(vert.vert.y);
+    writer.addFloat(vert.vert.z);
+
+    writer.addFloat(vert.texture.x);
+    writer.addFloat(vert.texture.y);
+
+    writer.addFloat(vert.normal.x);
+    writer.addFloat(vert.normal.y);
+    writer.addFloat(vert.normal.z);
+  }
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeIndexes(Writer& writer, const tp_math_utils::Geometry3D& mesh, const IndexEncoding& encoding)
+{
+  writer.addInt(uint32_t(mesh.indexes.size()));
+  if(mesh.indexes.empty())
+    return;
+
+  // Version 28+ the table is padded so that the payload that follows it is aligned, readers only use
+  // the bytes of the table that they need so this is transparent to them.
+  size_t tableSize = size_t(encoding.tableSize);
+  tableSize += paddingSize(writer.position() + 4 + 8 + 8 + tableSize);
+
+  writer.addInt(encoding.width | (encoding.delta?0x100:0));
+  writer.addUInt64(tableSize);
+  writer.addUInt64(encoding.payloadSize);
+
+  writer.addEncoded(tableSize, [&](uint8_t* data)
+  {
+    memset(data+encoding.tableSize, 0, tableSize-size_t(encoding.tableSize));
+
+    for(const auto& index : mesh.indexes)
+    {
+      if(index.type == mesh.triangleFan)
+        *(data++) = 1;
+      else if(index.type == mesh.triangleStrip)
+        *(data++) = 2;
+      else
+        *(data++) = 3;
+    }
+
+    for(const auto& index : mesh.indexes)
+      data = addVarint(data, index.indexes.size());
+  });
+
+  writer.addEncoded(size_t(encoding.payloadSize), [&](uint8_t* data)
+  {
+    if(encoding.delta)
+    {
+      uint32_t previous=0;
+      for(const auto& index : mesh.indexes)
+      {
+        for(int i : index.indexes)
+        {
+          data = addVarint(data, zigZag(int64_t(uint32_t(i)) - int64_t(previous)));
+          previous = uint32_t(i);
+        }
+      }
+    }
+    else
+    {
+      for(const auto& index : mesh.indexes)
+      {
+        for(int i : index.indexes)
+        {
+          uint32_t n = uint32_t(i);
+          memcpy(data, &n, encoding.width);
+          data+=encoding.width;
+        }
+      }
+    }
+  });
+}
+
+//##################################################################################################
+//! Compress a section if that makes it smaller, otherwise the returned chunk will be stored raw.
+template<typename WriteSection>
+CompressedChunk compressSection(const WriteSection& writeSection, bool keepData=true)
+{
+  SizeWriter sizeWriter;
+  writeSection(sizeWriter);
+
+  std::string raw;
+  raw.resize(sizeWriter.size);
+  BufferWriter bufferWriter{raw.data()};
+  writeSection(bufferWriter);
+
+  CompressedChunk chunk;
+  chunk.rawSize = raw.size();
+  chunk.data = compressChunk(raw.data(), raw.size());
+
+  // Encoding and sizes add 20 bytes, only keep the compressed data if it pays for itself.
+  if(chunk.data.size()+20 < raw.size())
+    chunk.compressedSize = chunk.data.size();
+
+  if(!keepData || chunk.compressedSize==0)
+    chunk.data = std::string();
+
+  return chunk;
+}
+
+//##################################################################################################
+//! Version 22+ vertex and index sections are wrapped in a chunk that records their encoding.
+/*!
+Only a SizeWriter can be passed a compressed chunk that has not kept its data.
+*/
+template<typename Writer, typename WriteSection>
+void writeChunk(Writer& writer, const CompressedChunk& chunk, const WriteSection& writeSection)
+{
+  if(chunk.compressedSize)
+  {
+    writer.addInt(1);
+    writer.addUInt64(chunk.rawSize);
+    writer.addUInt64(chunk.compressedSize);
+
+    if constexpr(std::is_same_v<Writer, SizeWriter>)
+      writer.size += size_t(chunk.compressedSize);
+    else
+      writer.addBytes(chunk.data);
+  }
+  else
+  {
+    writer.addInt(0);
+    writeSection(writer);
+  }
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeGeometry(Writer& writer, const EncodedGeometry& geometry)
+{
+  const auto& mesh = *geometry.mesh;
+  writeChunk(writer, geometry.verts, [&](auto& w){writeVerts(w, mesh);});
+  writeChunk(writer, geometry.indexes, [&](auto& w){writeIndexes(w, mesh, geometry.indexEncoding);});
+
+  // Version 28+ each LOD is padded so that the next one starts aligned.
+  writer.addPadding();
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeMeshGeometry(Writer& writer, const EncodedMesh& encodedMesh)
+{
+  // Version 27+ the size of each LOD comes first so that readers can skip to the one they want.
+  writer.addInt(uint32_t(encodedMesh.lods.size()));
+  for(const auto& lod : encodedMesh.lods)
+    writer.addUInt64(lod.size);
+  writer.addPadding();
+
+  for(const auto& lod : encodedMesh.lods)
+    writeGeometry(writer, lod);
+}
+
+//##################################################################################################
+//! Version 29+ the material index and comments follow the geometry in their own chunk so that they
+//! can be replaced without moving the geometry.
+template<typename Writer>
+void writeMesh(Writer& writer, const tp_math_utils::Geometry3D& mesh, const EncodedMesh& encodedMesh)
+{
+  writeMeshGeometry(writer, encodedMesh);
+  writeMeshMetadata(writer, encodedMesh.materialIndex, mesh.comments);
+  writer.addPadding();
+}
+
+//##################################################################################################
+EncodedGeometry encodeGeometry(const tp_math_utils::Geometry3D& mesh, const WriteOptions& options, bool keepCompressedData)
+{
+  EncodedGeometry geometry;
+  geometry.mesh = &mesh;
+  geometry.indexEncoding = calculateIndexEncoding(mesh, options.deltaIndexes);
+
+  if(options.compress)
+  {
+    geometry.verts   = compressSection([&](auto& w){writeVerts(w, mesh);}, keepCompressedData);
+    geometry.indexes = compressSection([&](auto& w){writeIndexes(w, mesh, geometry.indexEncoding);}, keepCompressedData);
+  }
+
+  SizeWriter sizeWriter;
+  writeGeometry(sizeWriter, geometry);
+  geometry.size = sizeWriter.size;
+  return geometry;
+}
+
+//##################################################################################################
+//! Generate options.generateLODs coarser versions of a mesh, stopping early if it can't be reduced.
+std::vector<tp_math_utils::Geometry3D> generateLODs(const tp_math_utils::Geometry3D& mesh, const WriteOptions& options)
+{
+  std::vector<tp_math_utils::Geometry3D> lods;
+  size_t triangles = countTriangles(mesh);
+  for(size_t l=0; l<options.generateLODs && triangles>0; l++)
+  {
+    tp_math_utils::Geometry3D lod = lods.empty()?mesh:lods.back();
+    simplifyMesh(lod, size_t(double(triangles)*double(options.lodRatio)));
+
+    size_t simplified = countTriangles(lod);
+    if(simplified>=triangles)
+      break;
+
+    if(options.optimizeMeshes)
+      optimizeMesh(lod);
+
+    triangles = simplified;
+    lods.push_back(std::move(lod));
+  }
+  return lods;
+}
+
+//##################################################################################################
+//! Optimize a mesh if that is enabled, find or generate its LODs, and encode them.
+/*!
+Everything derived from the mesh is owned by encodedMesh so that it can be released once the mesh
+has been written, see EncodedMesh::release.
+*/
+void encodeMesh(const tp_math_utils::Geometry3D& mesh,
+                const std::vector<tp_math_utils::Geometry3D>* suppliedLODs,
+                const WriteOptions& options,
+                bool keepCompressedData,
+                OptimizeStats* optimizeStats,
+                double* optimizeSeconds,
+                EncodedMesh& encodedMesh)
+{
+  const tp_math_utils::Geometry3D* source = &mesh;
+  if(options.optimizeMeshes)
+  {
+    ScopedTimer timer(optimizeSeconds);
+    encodedMesh.optimizedMesh = mesh;
+    optimizeMesh(encodedMesh.optimizedMesh, optimizeStats);
+    source = &encodedMesh.optimizedMesh;
+  }
+
+  const std::vector<tp_math_utils::Geometry3D>* lods = &encodedMesh.ownedLODs;
+  if(suppliedLODs && !suppliedLODs->empty())
+  {
+    if(options.optimizeMeshes)
+    {
+      ScopedTimer timer(optimizeSeconds);
+      encodedMesh.ownedLODs = *suppliedLODs;
+      for(auto& lod : encodedMesh.ownedLODs)
+        optimizeMesh(lod);
+    }
+    else
+      lods = suppliedLODs;
+  }
+  else
+    encodedMesh.ownedLODs = generateLODs(*source, options);
+
+  encodedMesh.lods.clear();
+  encodedMesh.lods.reserve(1+lods->size());
+  encodedMesh.lods.push_back(encodeGeometry(*source, options, keepCompressedData));
+  for(const auto& lod : *lods)
+    encodedMesh.lods.push_back(encodeGeometry(lod, options, keepCompressedData));
+
+  encodedMesh.verts = source->verts.size();
+  encodedMesh.indexes = 0;
+  for(const auto& indexes : source->indexes)
+    encodedMesh.indexes += indexes.indexes.size();
+  encodedMesh.lodCount = lods->size();
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeBounds(Writer& writer, const Bounds& bounds)
+{
+  writer.addFloat(bounds.min.x);
+  writer.addFloat(bounds.min.y);
+  writer.addFloat(bounds.min.z);
+  writer.addFloat(bounds.max.x);
+  writer.addFloat(bounds.max.y);
+  writer.addFloat(bounds.max.z);
+  writer.addFloat(bounds.center.x);
+  writer.addFloat(bounds.center.y);
+  writer.addFloat(bounds.center.z);
+  writer.addFloat(bounds.radius);
+  writer.addUInt64(uint64_t(bounds.verts));
+  writer.addUInt64(uint64_t(bounds.triangles));
+}
+
+//##################################################################################################
+//! Everything that needs to be calculated before the first byte of the file can be written.
+struct PreparedObject
+{
+  std::vector<MaterialEntry> materials;
+  std::vector<uint64_t> materialOffsets;
+  std::vector<uint64_t> materialSizes;
+  std::vector<EncodedMesh> encodedMeshes;
+  std::vector<size_t> meshSizes;
+  std::vector<Bounds> bounds;
+  Bounds totalBounds;
+  size_t materialTableSize{0};
+  size_t headerSize{0};
+  size_t size{0};
+};
+
+//##################################################################################################
+const std::vector<tp_math_utils::Geometry3D>* suppliedLODs(const WriteOptions& options, size_t meshIndex)
+{
+  return (options.lods && meshIndex<options.lods->size())?&options.lods->at(meshIndex):nullptr;
+}
+
+//##################################################################################################
+//! Encode and size every mesh, if keepMeshes is false only the sizes are kept.
+/*!
+With keepMeshes false the optimized copy, LODs, and compressed data of each mesh are released as
+soon as it has been sized so that memory use does not grow with the size of the object.
+*/
+PreparedObject prepareObject(const std::vector<tp_math_utils::Geometry3D>& object, const WriteOptions& options, bool keepMeshes)
+{
+  PreparedObject prepared;
+  WriteStats* stats = options.stats;
+
+  // Material state, optimization, LODs, index encodings, compressed chunks, and sizes are
+  // independent for each mesh so they are generated in parallel.
+  std::vector<MaterialEntry> meshMaterials(object.size());
+  auto& encodedMeshes = prepared.encodedMeshes;
+  encodedMeshes.resize(object.size());
+  prepared.meshSizes.resize(object.size());
+  prepared.bounds.resize(object.size());
+  std::vector<OptimizeStats> optimizeStats(options.optimizeStats?object.size():0);
+  std::vector<double> optimizeSeconds(stats?object.size():0, 0.0);
+  {
+    ScopedTimer timer(stats?&stats->encodeSeconds:nullptr);
+    parallelFor(object.size(), options.maxThreads, [&](size_t m)
+    {
+      const auto& mesh = object.at(m);
+      auto& encodedMesh = encodedMeshes.at(m);
+
+      meshMaterials.at(m) = makeMaterialEntry(mesh.material);
+
+      encodeMesh(mesh,
+                 suppliedLODs(options, m),
+                 options,
+                 keepMeshes,
+                 optimizeStats.empty()?nullptr:&optimizeStats.at(m),
+                 optimizeSeconds.empty()?nullptr:&optimizeSeconds.at(m),
+                 encodedMesh);
+
+      prepared.bounds.at(m) = calculateBounds(*encodedMesh.lods.front().mesh);
+
+      // The material index is fixed width so the size does not depend on the table built below.
+      SizeWriter sizeWriter;
+      writeMeshGeometry(sizeWriter, encodedMesh);
+      encodedMesh.geometrySize = sizeWriter.size;
+      writeMeshMetadata(sizeWriter, 0, mesh.comments);
+      encodedMesh.metadataSize = sizeWriter.size - encodedMesh.geometrySize;
+      sizeWriter.addPadding();
+      prepared.meshSizes.at(m) = sizeWriter.size;
+
+      if(!keepMeshes)
+        encodedMesh.release();
+    });
+  }
+
+  for(const auto& s : optimizeStats)
+  {
+    options.optimizeStats->meshes            += s.meshes;
+    options.optimizeStats->vertsBefore       += s.vertsBefore;
+    options.optimizeStats->vertsAfter        += s.vertsAfter;
+    options.optimizeStats->triangles         += s.triangles;
+    options.optimizeStats->cacheMissesBefore += s.cacheMissesBefore;
+    options.optimizeStats->cacheMissesAfter  += s.cacheMissesAfter;
+  }
+
+  // Materials are written once to a table and referenced by index from each mesh. This is done in
+  // mesh order so the output does not depend on the number of threads.
+  auto& materials = prepared.materials;
+  std::unordered_map<std::string, uint32_t> materialIndexes;
+  {
+    ScopedTimer timer(stats?&stats->materialsSeconds:nullptr);
+    for(size_t m=0; m<object.size(); m++)
+    {
+      auto& material = meshMaterials.at(m);
+
+      const auto& uv = *material.uvTransformation;
+      float uvFloats[7] = {uv.skewUV.x, uv.skewUV.y, uv.scaleUV.x, uv.scaleUV.y, uv.translateUV.x, uv.translateUV.y, uv.rotateUV};
+
+      std::string key = material.name;
+      key += '\0';
+      key += material.state;
+      key.append(reinterpret_cast<const char*>(uvFloats), sizeof(uvFloats));
+
+      auto i = materialIndexes.emplace(key, uint32_t(materials.size()));
+      if(i.second)
+        materials.push_back(std::move(material));
+      encodedMeshes.at(m).materialIndex = i.first->second;
+    }
+  }
+
+  prepared.totalBounds = combineBounds(prepared.bounds);
+
+  // The fixed header, the bounds section, a table of the offset and size of each mesh, the material
+  // table, and the materials, padded so that the first mesh is aligned.
+  prepared.materialTableSize = materialTableHeaderSize + materials.size()*materialEntrySize;
+  prepared.headerSize = fixedHeaderSize + (object.size()+1)*boundsSize + object.size()*meshEntrySize + prepared.materialTableSize;
+  for(const auto& material : materials)
+  {
+    SizeWriter sizeWriter;
+    writeMaterial(sizeWriter, material);
+    prepared.materialOffsets.push_back(prepared.headerSize);
+    prepared.materialSizes.push_back(sizeWriter.size);
+    prepared.headerSize += sizeWriter.size;
+  }
+  prepared.headerSize += paddingSize(prepared.headerSize);
+
+  prepared.size = prepared.headerSize;
+  for(size_t meshSize : prepared.meshSizes)
+    prepared.size += meshSize;
+
+  if(stats)
+  {
+    stats->bytes += prepared.size;
+    stats->meshes += object.size();
+    stats->materials += materials.size();
+    for(const auto& encodedMesh : encodedMeshes)
+    {
+      stats->lods += encodedMesh.lodCount;
+      stats->verts += encodedMesh.verts;
+      stats->indexes += encodedMesh.indexes;
+    }
+
+    for(double seconds : optimizeSeconds)
+      stats->optimizeSeconds += seconds;
+  }
+
+  return prepared;
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeHeader(Writer& writer, const std::vector<tp_math_utils::Geometry3D>& object, const PreparedObject& prepared)
+{
+  size_t boundsSectionSize = (object.size()+1)*boundsSize;
+  size_t meshTableOffset = fixedHeaderSize + boundsSectionSize;
+  size_t materialTableOffset = meshTableOffset + object.size()*meshEntrySize;
+
+  // Version 28+ a fixed size header gives the offset of each section so that any of them can be read
+  // without reading the ones before it.
+  writer.addInt(uint32_t(0)-maxVersion);
+  writer.addInt(uint32_t(object.size()));
+  writer.addUInt64(uint64_t(boundsSectionSize));
+  writer.addUInt64(uint64_t(fixedHeaderSize));
+  writer.addUInt64(uint64_t(meshTableOffset));
+  writer.addUInt64(uint64_t(materialTableOffset));
+  writer.addUInt64(uint64_t(prepared.materialTableSize));
+  writer.addInt(uint32_t(blockAlignment));
+  writer.addInt(uint32_t(meshEntrySize));
+  writer.addUInt64(0); // Version 29+ bytes of chunks that have been replaced by patching.
+
+  // Version 26+ the bounds come first so that they can be read without reading the rest of the file.
+  writeBounds(writer, prepared.totalBounds);
+  for(const auto& bounds : prepared.bounds)
+    writeBounds(writer, bounds);
+
+  // Version 29+ the geometry and metadata of each mesh are referenced separately.
+  uint64_t offset = prepared.headerSize;
+  for(size_t m=0; m<object.size(); m++)
+  {
+    const auto& encodedMesh = prepared.encodedMeshes.at(m);
+    writer.addUInt64(offset);
+    writer.addUInt64(encodedMesh.geometrySize);
+    writer.addUInt64(offset + encodedMesh.geometrySize);
+    writer.addUInt64(encodedMesh.metadataSize);
+    offset += prepared.meshSizes.at(m);
+  }
+
+  writeMaterialTable(writer, prepared.materialOffsets, prepared.materialSizes);
+  for(const auto& material : prepared.materials)
+    writeMaterial(writer, material);
+  writer.addPadding();
+}
+
+//##################################################################################################
+//! Encode meshes [first, last) again and write each to its own block.
+/*!
+The sizing pass of the streaming writer does not keep meshes, so each mesh is optimized, has its
+LODs built, and is compressed again here in parallel, just before it is written. Everything is
+released once the mesh has been written.
+*/
+void encodeWindow(const std::vector<tp_math_utils::Geometry3D>& object,
+                  PreparedObject& prepared,
+                  const WriteOptions& options,
+                  size_t first,
+                  size_t last,
+                  std::vector<std::string>& blocks)
+{
+  blocks.resize(last-first);
+  parallelFor(last-first, options.maxThreads, [&](size_t i)
+  {
+    size_t m = first+i;
+    auto& encodedMesh = prepared.encodedMeshes.at(m);
+    encodeMesh(object.at(m), suppliedLODs(options, m), options, true, nullptr, nullptr, encodedMesh);
+
+    auto& block = blocks.at(i);
+    block.resize(prepared.meshSizes.at(m));
+    BufferWriter writer{block.data()};
+    writeMesh(writer, object.at(m), encodedMesh);
+
+    encodedMesh.release();
+  });
+}
+
+//##################################################################################################
+//! A bounded pool of threads that runs resource export jobs, errors are collected rather than thrown.
+struct ResourcePool
+{
+  TP_NONCOPYABLE(ResourcePool);
+
+  std::mutex mutex;
+  std::condition_variable waitCondition;
+  std::deque<std::function<void()>> jobs;
+  std::vector<std::thread> threads;
+  std::vector<std::string> errors;
+  size_t maxThreads;
+  size_t idle{0};
+  bool finished{false};
+
+  //################################################################################################
+  ResourcePool(size_t maxThreads_):
+    maxThreads(maxThreads_?maxThreads_:std::max(size_t(1), size_t(std::thread::hardware_concurrency())))
+  {
+
+  }
+
+  //################################################################################################
+  ~ResourcePool()
+  {
+    finish();
+  }
+
+  //################################################################################################
+  //! Queue a job, if succeeded is set it is incremented once the job has completed without throwing.
+  void addJob(const std::string& description, const std::function<void()>& job, size_t* succeeded=nullptr)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs.emplace_back([this, description, job, succeeded]
+    {
+      try
+      {
+        job();
+        if(succeeded)
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          (*succeeded)++;
+        }
+      }
+      catch(const std::exception& e)
+      {
+        addError(description + ": " + e.what());
+      }
+      catch(...)
+      {
+        addError(description);
+      }
+    });
+
+    // Threads are only started as jobs are discovered, up to the limit.
+    if(idle==0 && threads.size()<maxThreads)
+      threads.emplace_back([this]{run();});
+    else
+      waitCondition.notify_one();
+  }
+
+  //################################################################################################
+  void addError(const std::string& error)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    errors.push_back(error);
+  }
+
+  //################################################################################################
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+      if(!jobs.empty())
+      {
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+        continue;
+      }
+
+      if(finished)
+        return;
+
+      idle++;
+      waitCondition.wait(lock);
+      idle--;
+    }
+  }
+
+  //################################################################################################
+  //! Wait for all jobs to complete.
+  void finish()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      finished = true;
+    }
+    waitCondition.notify_all();
+
+    for(auto& thread : threads)
+      thread.join();
+    threads.clear();
+  }
+};
+
+//##################################################################################################
+//! Calls writeGeometry and saves the textures and external files used by the object.
+/*!
+If options.concurrentResources is set the resources are sent to a pool as they are discovered and
+saved while writeGeometry runs, errors are reported once everything has completed.
+*/
+void saveResources(const std::vector<tp_math_utils::Geometry3D>& object,
+                   const std::function<void(const tp_utils::StringID&)>& saveTexture,
+                   const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
+                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                   const WriteOptions& options,
+                   const std::function<void()>& writeGeometry)
+{
+  WriteStats* stats = options.stats;
+
+  if(!options.concurrentResources)
+  {
+    writeGeometry();
+
+    ScopedTimer timer(stats?&stats->resourcesSeconds:nullptr);
+    std::unordered_set<tp_utils::StringID> textures;
+    std::vector<std::pair<tp_utils::StringID, tp_utils::StringID>> files;
+    for(const auto& mesh : object)
+    {
+      mesh.material.allTextureIDs(textures, extractTextureIDs);
+      mesh.material.appendFileIDs(files);
+    }
+
+    for(const auto& texture : textures)
+    {
+      if(texture.isValid())
+      {
+        saveTexture(texture);
+        if(stats)
+          stats->textures++;
+      }
+    }
+
+    for(const auto& file : files)
+    {
+      if(file.first.isValid() && file.second.isValid())
+      {
+        saveExternalFile(file.first, file.second);
+        if(stats)
+          stats->files++;
+      }
+    }
+
+    return;
+  }
+
+  std::vector<std::string> errors;
+  {
+    ResourcePool pool(options.maxResourceThreads);
+    size_t* savedTextures = stats?&stats->textures:nullptr;
+    size_t* savedFiles = stats?&stats->files:nullptr;
+
+    // Each resource is only saved once, two jobs writing the same file would race.
+    std::unordered_set<tp_utils::StringID> textures;
+    std::unordered_map<tp_utils::StringID, std::unordered_set<tp_utils::StringID>> files;
+    for(const auto& mesh : object)
+    {
+      std::unordered_set<tp_utils::StringID> meshTextures;
+      mesh.material.allTextureIDs(meshTextures, extractTextureIDs);
+      for(const auto& texture : meshTextures)
+        if(texture.isValid() && textures.insert(texture).second)
+          pool.addJob("Failed to save texture: " + texture.toString(), [&saveTexture, texture]{saveTexture(texture);}, savedTextures);
+
+      std::vector<std::pair<tp_utils::StringID, tp_utils::StringID>> meshFiles;
+      mesh.material.appendFileIDs(meshFiles);
+      for(const auto& file : meshFiles)
+        if(file.first.isValid() && file.second.isValid() && files[file.first].insert(file.second).second)
+          pool.addJob("Failed to save file: " + file.second.toString(), [&saveExternalFile, file]{saveExternalFile(file.first, file.second);}, savedFiles);
+    }
+
+    writeGeometry();
+
+    {
+      // Only the time spent waiting for resources after the geometry is complete is counted.
+      ScopedTimer timer(stats?&stats->resourcesSeconds:nullptr);
+      pool.finish();
+    }
+    errors = std::move(pool.errors);
+  }
+
+  for(const auto& error : errors)
+    tpWarning() << error;
+
+  if(options.resourceErrors)
+    options.resourceErrors->insert(options.resourceErrors->end(), errors.begin(), errors.end());
+}
+}
+
 //##################################################################################################
 void writeObjectAndResourcesToFile(const std::vector<tp_math_utils::Geometry3D>& object,
                                    const std::string& filePath,
                                    const std::function<void(const tp_utils::StringID&, const std::string&)>& saveTexture,
                                    const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
                                    const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
+{
+  writeObjectAndResourcesToFile(object, filePath, saveTexture, saveExternalFile, extractTextureIDs, WriteOptions());
+}
+
+//##################################################################################################
+void writeObjectAndResourcesToFile(const std::vector<tp_math_utils::Geometry3D>& object,
+                                   const std::string& filePath,
+                                   const std::function<void(const tp_utils::StringID&, const std::string&)>& saveTexture,
+                                   const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const WriteOptions& options)
 {
   std::string directory = getAssociatedFilePath(filePath);
 
-  std::string objectData = serializeObject(object, [&](const tp_utils::StringID& name)
+  auto saveTextureToDirectory = [&](const tp_utils::StringID& name)
   {
     if(name.isValid())
       saveTexture(name, directory + cleanTextureName(name) + ".png");
-  },
-  [&](const tp_utils::StringID& type, const tp_utils::StringID& name)
+  };
+
+  auto saveExternalFileToDirectory = [&](const tp_utils::StringID& type, const tp_utils::StringID& name)
   {
     if(type.isValid() && name.isValid())
       saveExternalFile(type, name, directory + cleanTextureName(name));
-  },
-  extractTextureIDs);
-  tp_utils::writeBinaryFile(filePath, objectData);
+  };
+
+  // The object is written to a temporary file that replaces filePath once it is complete, so a
+  // failed write never leaves a truncated file behind.
+  std::string tmpPath = filePath + ".tmp";
+  bool ok=false;
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if(options.boundedMemory)
+    {
+      ok = serializeObject(object, [&](const char* data, size_t size)
+      {
+        out.write(data, std::streamsize(size));
+        return bool(out);
+      }, saveTextureToDirectory, saveExternalFileToDirectory, extractTextureIDs, options);
+    }
+    else
+    {
+      std::string data = serializeObject(object, saveTextureToDirectory, saveExternalFileToDirectory, extractTextureIDs, options);
+      out.write(data.data(), std::streamsize(data.size()));
+      ok = bool(out);
+    }
+
+    out.close();
+    ok = ok && !out.fail() && syncFile(tmpPath);
+  }
+
+  std::error_code ec;
+  if(ok)
+    std::filesystem::rename(tmpPath, filePath, ec);
+
+  if(!ok || ec)
+  {
+    std::remove(tmpPath.c_str());
+    tpWarning() << "Failed to write object to: " << filePath;
+    return;
+  }
+
+  syncParentDirectory(filePath);
 }
 
 //##################################################################################################
@@ -37,6 +952,18 @@ void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>&
                                    const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
                                    const std::function<void(const std::string& path, const std::string& data, bool binary)>& saveFile,
                                    const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
+{
+  writeObjectAndResourcesToData(object, filePath, saveTexture, saveExternalFile, saveFile, extractTextureIDs, WriteOptions());
+}
+
+//##################################################################################################
+void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>& object,
+                                   const std::string& filePath,
+                                   const std::function<void(const tp_utils::StringID&, const std::string&)>& saveTexture,
+                                   const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&, const std::string&)>& saveExternalFile,
+                                   const std::function<void(const std::string& path, const std::string& data, bool binary)>& saveFile,
+                                   const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                                   const WriteOptions& options)
 {
   std::string directory = getAssociatedFilePath(filePath);
 
@@ -50,7 +977,7 @@ void writeObjectAndResourcesToData(const std::vector<tp_math_utils::Geometry3D>&
     if(type.isValid() && name.isValid())
       saveExternalFile(type, name, directory + cleanTextureName(name));
   },
-  extractTextureIDs);
+  extractTextureIDs, options);
   saveFile(filePath, objectData, true);
 }
 
@@ -60,131 +987,99 @@ std::string serializeObject(const std::vector<tp_math_utils::Geometry3D>& object
                             const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
                             const tp_math_utils::ExtractTextureIDs& extractTextureIDs)
 {
-  auto run = [&object](const auto& addInt, const auto& addFloat, const auto& addString)
-  {
-    uint32_t maxVersion=20;
-
-    addInt(uint32_t(0)-maxVersion);
-    addInt(uint32_t(object.size()));
-    for(const auto& mesh : object)
-    {
-      addInt(uint32_t(mesh.comments.size()));
-      for(const auto& comment : mesh.comments)
-        addString(comment);
-
-      addInt(uint32_t(mesh.verts.size()));
-      for(const auto& vert : mesh.verts)
-      {
-        addFloat(vert.vert.x);
-        addFloat(vert.vert.y);
-        addFloat(vert.vert.z);
-
-        addFloat(vert.texture.x);
-        addFloat(vert.texture.y);
+  return serializeObject(object, saveTexture, saveExternalFile, extractTextureIDs, WriteOptions());
+}
 
-        addFloat(vert.normal.x);
-        addFloat(vert.normal.y);
-        addFloat(vert.normal.z);
-      }
+//##################################################################################################
+std::string serializeObject(const std::vector<tp_math_utils::Geometry3D>& object,
+                            const std::function<void(const tp_utils::StringID&)>& saveTexture,
+                            const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
+                            const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                            const WriteOptions& options)
+{
+  WriteStats* stats = options.stats;
+  ScopedTimer timer(stats?&stats->totalSeconds:nullptr);
 
-      addInt(uint32_t(mesh.indexes.size()));
-      for(const auto& index : mesh.indexes)
-      {
-        if(index.type == mesh.triangleFan)
-          addInt(1);
-        else if(index.type == mesh.triangleStrip)
-          addInt(2);
-        else
-          addInt(3);
-
-        addInt(uint32_t(index.indexes.size()));
-        for(int i : index.indexes)
-          addInt(uint32_t(i));
-      }
+  std::string result;
+  saveResources(object, saveTexture, saveExternalFile, extractTextureIDs, options, [&]
+  {
+    PreparedObject prepared = prepareObject(object, options, true);
 
-      addString(mesh.material.name.toString());
+    ScopedTimer timer(stats?&stats->writeSeconds:nullptr);
+    result.resize(prepared.size);
+    {
+      BufferWriter writer{result.data()};
+      writeHeader(writer, object, prepared);
+    }
 
+    // Each mesh has a known offset so they can be written to the result concurrently.
+    std::vector<size_t> meshOffsets(object.size());
+    {
+      size_t offset = prepared.headerSize;
+      for(size_t m=0; m<object.size(); m++)
       {
-        nlohmann::json j;
-        mesh.material.saveState(j);
-        addString(j.dump());
+        meshOffsets.at(m) = offset;
+        offset += prepared.meshSizes.at(m);
       }
-
-      addFloat(mesh.material.uvTransformation.skewUV.x);
-      addFloat(mesh.material.uvTransformation.skewUV.y);
-      addFloat(mesh.material.uvTransformation.scaleUV.x);
-      addFloat(mesh.material.uvTransformation.scaleUV.y);
-      addFloat(mesh.material.uvTransformation.translateUV.x);
-      addFloat(mesh.material.uvTransformation.translateUV.y);
-      addFloat(mesh.material.uvTransformation.rotateUV);
     }
-  };
 
-  size_t resultSize=0;
-  {
-    auto addInt = [&](uint32_t)
+    parallelFor(object.size(), options.maxThreads, [&](size_t m)
     {
-      resultSize+=4;
-    };
+      BufferWriter writer{result.data()+meshOffsets.at(m)};
+      writeMesh(writer, object.at(m), prepared.encodedMeshes.at(m));
+    });
+  });
 
-    auto addFloat = [&](float)
-    {
-      resultSize+=4;
-    };
+  return result;
+}
 
-    auto addString = [&](const std::string& s)
-    {
-      resultSize+=4;
-      resultSize+=s.size();
-    };
-    run(addInt, addFloat, addString);
-  }
+//##################################################################################################
+bool serializeObject(const std::vector<tp_math_utils::Geometry3D>& object,
+                     const std::function<bool(const char* data, size_t size)>& sink,
+                     const std::function<void(const tp_utils::StringID&)>& saveTexture,
+                     const std::function<void(const tp_utils::StringID&, const tp_utils::StringID&)>& saveExternalFile,
+                     const tp_math_utils::ExtractTextureIDs& extractTextureIDs,
+                     const WriteOptions& options)
+{
+  WriteStats* stats = options.stats;
+  ScopedTimer timer(stats?&stats->totalSeconds:nullptr);
 
-  std::string result;
-  result.resize(resultSize);
+  SinkWriter writer(sink, options.blockSize);
+  saveResources(object, saveTexture, saveExternalFile, extractTextureIDs, options, [&]
   {
-    char* data = result.data();
-    auto addInt = [&](uint32_t n)
-    {
-      memcpy(data, &n, 4);
-      data+=4;
-    };
+    // Meshes are only sized here, they are encoded again as they are written.
+    PreparedObject prepared = prepareObject(object, options, false);
 
-    auto addFloat = [&](float n)
-    {
-      memcpy(data, &n, 4);
-      data+=4;
-    };
+    ScopedTimer timer(stats?&stats->writeSeconds:nullptr);
+    writeHeader(writer, object, prepared);
 
-    auto addString = [&](const std::string& s)
+    // Meshes are encoded in parallel a window at a time and passed to the sink in order. A window
+    // holds about a block per thread, or a single mesh if that is larger.
+    size_t threads = options.maxThreads?options.maxThreads:std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+    size_t windowSize = std::max(options.blockSize, size_t(64))*threads;
+
+    std::vector<std::string> blocks;
+    for(size_t first=0; first<object.size() && writer.ok;)
     {
-      uint32_t n = uint32_t(s.size());
-      memcpy(data, &n, 4);
-      data+=4;
+      size_t last=first+1;
+      size_t size=prepared.meshSizes.at(first);
+      for(; last<object.size() && size+prepared.meshSizes.at(last)<=windowSize; last++)
+        size+=prepared.meshSizes.at(last);
 
-      memcpy(data, s.data(), s.size());
-      data+=s.size();
-    };
-    run(addInt, addFloat, addString);
-  }
+      encodeWindow(object, prepared, options, first, last, blocks);
+      for(auto& block : blocks)
+      {
+        writer.addBytes(block);
+        block = std::string();
+      }
 
-  std::unordered_set<tp_utils::StringID> textures;
-  std::vector<std::pair<tp_utils::StringID, tp_utils::StringID>> files;
-  for(const auto& mesh : object)
-  {
-    mesh.material.allTextureIDs(textures, extractTextureIDs);
-    mesh.material.appendFileIDs(files);
-  }
+      first=last;
+    }
 
-  for(const auto& texture : textures)
-    if(texture.isValid())
-      saveTexture(texture);
-  
-  for(const auto& file : files)
-    if(file.first.isValid() && file.second.isValid())
-      saveExternalFile(file.first, file.second);
+    writer.flush();
+  });
 
-  return result;
+  return writer.ok;
 }
 
 }
@@ -0,0 +1,308 @@
+#ifndef tp_boj_WriteBOJPrivate_h
+#define tp_boj_WriteBOJPrivate_h
+
+#include "tp_boj/WriteBOJ.h"
+
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+//! The layout constants, writers, and material encoding shared by WriteBOJ.cpp, PatchBOJ.cpp, and
+//! BOJInfo.cpp. This is not part of the public interface.
+
+namespace tp_boj
+{
+
+//##################################################################################################
+constexpr uint32_t maxVersion=29;
+
+//##################################################################################################
+//! Version 28+ mesh blocks, vertex records, and index payloads start on a multiple of this many
+//! bytes from the start of the file so that they can be used in place. This must match
+//! ReadBOJPrivate.h.
+constexpr size_t blockAlignment=64;
+
+//##################################################################################################
+//! Version 28+ the size of the fixed header that gives the offset of each section.
+constexpr size_t fixedHeaderSize=64;
+
+//##################################################################################################
+//! Version 26+ the size of the bounds record for the object and each mesh.
+constexpr size_t boundsSize = 10*sizeof(float) + 2*sizeof(uint64_t);
+
+//##################################################################################################
+//! Version 29+ each mesh table entry is the offset and size of the geometry and of the metadata.
+constexpr size_t meshEntrySize=32;
+
+//##################################################################################################
+//! Version 29+ the material table is a count and a reserved word followed by the offset and size of
+//! each material.
+constexpr size_t materialTableHeaderSize=8;
+constexpr size_t materialEntrySize=16;
+
+//##################################################################################################
+inline size_t paddingSize(size_t offset)
+{
+  return (blockAlignment - offset%blockAlignment) % blockAlignment;
+}
+
+//##################################################################################################
+//! Flush the contents of a file that have already been written through to the disk, this is
+//! defined in PatchBOJ.cpp.
+bool syncFile(const std::string& path);
+
+//##################################################################################################
+//! Flush the directory that contains a file so that a rename into it is on the disk.
+void syncParentDirectory(const std::string& path);
+
+//##################################################################################################
+//! Counts the bytes that would be written.
+struct SizeWriter
+{
+  size_t size{0};
+
+  size_t position() const{return size;}
+  void addPadding(){size+=paddingSize(size);}
+  void addInt(uint32_t){size+=4;}
+  void addUInt64(uint64_t){size+=8;}
+  void addFloat(float){size+=4;}
+  void addString(const std::string& s){size+=4+s.size();}
+  void addBytes(const std::string& s){size+=s.size();}
+
+  template<typename Fill>
+  void addEncoded(size_t n, const Fill&){size+=n;}
+};
+
+//##################################################################################################
+//! Writes into a buffer that has already been sized using a SizeWriter.
+struct BufferWriter
+{
+  const char* start;
+  char* data;
+
+  //################################################################################################
+  BufferWriter(char* data_):
+    start(data_),
+    data(data_)
+  {
+
+  }
+
+  //################################################################################################
+  //! Bytes written so far, padding is relative to where the writer started.
+  size_t position() const
+  {
+    return size_t(data-start);
+  }
+
+  //################################################################################################
+  void addPadding()
+  {
+    size_t n = paddingSize(position());
+    memset(data, 0, n);
+    data+=n;
+  }
+
+  //################################################################################################
+  void addInt(uint32_t n)
+  {
+    memcpy(data, &n, 4);
+    data+=4;
+  }
+
+  //################################################################################################
+  void addUInt64(uint64_t n)
+  {
+    memcpy(data, &n, 8);
+    data+=8;
+  }
+
+  //################################################################################################
+  void addFloat(float n)
+  {
+    memcpy(data, &n, 4);
+    data+=4;
+  }
+
+  //################################################################################################
+  void addString(const std::string& s)
+  {
+    addInt(uint32_t(s.size()));
+    addBytes(s);
+  }
+
+  //################################################################################################
+  void addBytes(const std::string& s)
+  {
+    memcpy(data, s.data(), s.size());
+    data+=s.size();
+  }
+
+  //################################################################################################
+  //! fill must write exactly n bytes.
+  template<typename Fill>
+  void addEncoded(size_t n, const Fill& fill)
+  {
+    fill(reinterpret_cast<uint8_t*>(data));
+    data+=n;
+  }
+};
+
+//##################################################################################################
+//! Writes to a sink in blocks of at most blockSize bytes.
+struct SinkWriter
+{
+  const std::function<bool(const char*, size_t)>& sink;
+  std::string buffer;
+  size_t used{0};
+  size_t flushed{0};
+  bool ok{true};
+
+  //################################################################################################
+  SinkWriter(const std::function<bool(const char*, size_t)>& sink_, size_t blockSize):
+    sink(sink_)
+  {
+    buffer.resize(std::max(blockSize, size_t(64)));
+  }
+
+  //################################################################################################
+  void flush()
+  {
+    if(used && ok)
+      ok = sink(buffer.data(), used);
+    flushed+=used;
+    used=0;
+  }
+
+  //################################################################################################
+  size_t position() const
+  {
+    return flushed+used;
+  }
+
+  //################################################################################################
+  void addPadding()
+  {
+    static const char zeros[blockAlignment]={};
+    addRaw(zeros, paddingSize(position()));
+  }
+
+  //################################################################################################
+  void addRaw(const void* data, size_t n)
+  {
+    auto src = static_cast<const char*>(data);
+    while(n)
+    {
+      if(used==buffer.size())
+        flush();
+
+      size_t c = std::min(n, buffer.size()-used);
+      memcpy(buffer.data()+used, src, c);
+      used+=c;
+      src+=c;
+      n-=c;
+    }
+  }
+
+  void addInt(uint32_t n){addRaw(&n, 4);}
+  void addUInt64(uint64_t n){addRaw(&n, 8);}
+  void addFloat(float n){addRaw(&n, 4);}
+  void addBytes(const std::string& s){addRaw(s.data(), s.size());}
+
+  //################################################################################################
+  void addString(const std::string& s)
+  {
+    addInt(uint32_t(s.size()));
+    addBytes(s);
+  }
+
+  //################################################################################################
+  template<typename Fill>
+  void addEncoded(size_t n, const Fill& fill)
+  {
+    if(n<=buffer.size())
+    {
+      if(buffer.size()-used < n)
+        flush();
+
+      fill(reinterpret_cast<uint8_t*>(buffer.data()+used));
+      used+=n;
+    }
+    else
+    {
+      // Larger than a block, this is bounded by the size of a single mesh section.
+      std::string encoded;
+      encoded.resize(n);
+      fill(reinterpret_cast<uint8_t*>(encoded.data()));
+      addBytes(encoded);
+    }
+  }
+};
+
+//##################################################################################################
+//! A distinct material in the version 24+ material table.
+struct MaterialEntry
+{
+  std::string name;
+  std::string state;
+  const tp_math_utils::UVTransformation* uvTransformation{nullptr};
+};
+
+//##################################################################################################
+template<typename Writer>
+void writeMaterial(Writer& writer, const MaterialEntry& material)
+{
+  writer.addString(material.name);
+  writer.addString(material.state);
+
+  writer.addFloat(material.uvTransformation->skewUV.x);
+  writer.addFloat(material.uvTransformation->skewUV.y);
+  writer.addFloat(material.uvTransformation->scaleUV.x);
+  writer.addFloat(material.uvTransformation->scaleUV.y);
+  writer.addFloat(material.uvTransformation->translateUV.x);
+  writer.addFloat(material.uvTransformation->translateUV.y);
+  writer.addFloat(material.uvTransformation->rotateUV);
+}
+
+//##################################################################################################
+//! Version 25+ the material state is stored as CBOR rather than JSON text.
+inline MaterialEntry makeMaterialEntry(const tp_math_utils::Material& material)
+{
+  MaterialEntry entry;
+  entry.name = material.name.toString();
+  entry.uvTransformation = &material.uvTransformation;
+
+  nlohmann::json j;
+  material.saveState(j);
+  std::vector<uint8_t> cbor = nlohmann::json::to_cbor(j);
+  entry.state.assign(cbor.begin(), cbor.end());
+  return entry;
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeMaterialTable(Writer& writer, const std::vector<uint64_t>& offsets, const std::vector<uint64_t>& sizes)
+{
+  writer.addInt(uint32_t(offsets.size()));
+  writer.addInt(0); // Reserved.
+  for(size_t i=0; i<offsets.size(); i++)
+  {
+    writer.addUInt64(offsets.at(i));
+    writer.addUInt64(sizes.at(i));
+  }
+}
+
+//##################################################################################################
+template<typename Writer>
+void writeMeshMetadata(Writer& writer, uint32_t materialIndex, const std::vector<std::string>& comments)
+{
+  writer.addInt(materialIndex);
+
+  writer.addInt(uint32_t(comments.size()));
+  for(const auto& comment : comments)
+    writer.addString(comment);
+}
+
+}
+
+#endif
@@ -0,0 +1,746 @@
+#include "tp_boj/ReadBOJ.h"
+#include "tp_boj/WriteBOJ.h"
+#include "tp_boj/BatchReadBOJ.h"
+#include "tp_boj/BOJInfo.h"
+#include "tp_boj/BOJView.h"
+#include "tp_boj/PatchBOJ.h"
+
+#include "tp_math_utils/materials/OpenGLMaterial.h"
+
+#include "tp_utils/JSONUtils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+
+//##################################################################################################
+struct BenchConfig
+{
+  std::string name;
+  size_t meshes{100};
+  size_t verts{1000};
+  bool strips{false};
+  size_t materials{4};
+  size_t texturesPerMaterial{1};
+  size_t iterations{5};
+  tp_boj::WriteOptions writeOptions;
+  tp_boj::ReadOptions readOptions;
+};
+
+//##################################################################################################
+std::string filePath = "tp_boj_bench.boj";
+
+//##################################################################################################
+//! A memory field from /proc/self/status in MB, 0 if it is not available.
+double procStatusMB(const char* field)
+{
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  size_t n = strlen(field);
+  while(std::getline(status, line))
+    if(line.compare(0, n, field)==0)
+      return double(std::stoull(line.substr(n))) / 1024.0;
+#else
+  TP_UNUSED(field);
+#endif
+  return 0.0;
+}
+
+//##################################################################################################
+//! Peak resident set size in MB, since the last resetPeakRSS where that is supported, otherwise
+//! over the life of the process. 0 if this is not available on this platform.
+double peakRSS()
+{
+  if(double hwm = procStatusMB("VmHWM:"); hwm>0.0)
+    return hwm;
+
+#if defined(__linux__) || defined(__APPLE__)
+  rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+
+#ifdef __APPLE__
+  return double(usage.ru_maxrss) / (1024.0*1024.0);
+#else
+  return double(usage.ru_maxrss) / 1024.0;
+#endif
+
+#else
+  return 0.0;
+#endif
+}
+
+//##################################################################################################
+//! The baseline that report subtracts from peakRSS, set by startMeasurement.
+double baselineRSS=0.0;
+
+//##################################################################################################
+//! Start measuring the memory used by a new case.
+/*!
+ru_maxrss only ever grows so on its own it reports the largest case run so far rather than the
+current one. On Linux the peak is reset and the baseline is the current resident set size, so each
+case reports the memory it used on top of what was already resident. Elsewhere the baseline is the
+peak so far, and a case that stays below an earlier peak reports 0.
+*/
+void startMeasurement()
+{
+#ifdef __linux__
+  // Writing 5 resets VmHWM to the current resident set size, this requires Linux 4.0+.
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5";
+  clearRefs.flush();
+  if(clearRefs)
+  {
+    baselineRSS = procStatusMB("VmRSS:");
+    return;
+  }
+#endif
+  baselineRSS = peakRSS();
+}
+
+//##################################################################################################
+//! Returns the fastest of iterations runs in seconds, this starts a new memory measurement.
+template<typename T>
+double bestTime(size_t iterations, const T& fn)
+{
+  startMeasurement();
+
+  double best=0.0;
+  for(size_t i=0; i<iterations; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(i==0 || seconds<best)
+      best = seconds;
+  }
+  return best;
+}
+
+//##################################################################################################
+//! Print the throughput and the peak memory of the case timed by the last call to bestTime.
+void report(const std::string& name, const std::string& operation, size_t bytes, size_t meshes, double seconds)
+{
+  seconds = std::max(seconds, 1e-9);
+  printf("%-28s %-12s %10.1f MB/s %12.0f meshes/s %10.1f MB peak RSS growth\n",
+         name.c_str(),
+         operation.c_str(),
+         double(bytes) / (1024.0*1024.0) / seconds,
+         double(meshes) / seconds,
+         std::max(peakRSS() - baselineRSS, 0.0));
+}
+
+//##################################################################################################
+//! Returns true if decoded matches the object that was written, every field that a version 21+
+//! file stores must survive the round trip exactly.
+bool sameGeometry(const std::vector<tp_math_utils::Geometry3D>& object, const std::vector<tp_math_utils::Geometry3D>& decoded)
+{
+  if(decoded.size() != object.size())
+    return false;
+
+  for(size_t m=0; m<object.size(); m++)
+  {
+    const auto& a = object.at(m);
+    const auto& b = decoded.at(m);
+
+    if(a.comments != b.comments || a.verts.size() != b.verts.size() || a.indexes.size() != b.indexes.size())
+      return false;
+
+    for(size_t v=0; v<a.verts.size(); v++)
+    {
+      const auto& va = a.verts.at(v);
+      const auto& vb = b.verts.at(v);
+      if(va.vert != vb.vert || va.texture != vb.texture || va.normal != vb.normal)
+        return false;
+    }
+
+    for(size_t i=0; i<a.indexes.size(); i++)
+      if(a.indexes.at(i).type != b.indexes.at(i).type || a.indexes.at(i).indexes != b.indexes.at(i).indexes)
+        return false;
+
+    nlohmann::json ja;
+    nlohmann::json jb;
+    a.material.saveState(ja);
+    b.material.saveState(jb);
+    if(a.material.name != b.material.name || ja != jb)
+      return false;
+  }
+
+  return true;
+}
+
+//##################################################################################################
+//! Print a failure if decoded does not match object, returns false if it does not.
+bool checkRoundTrip(const BenchConfig& config, const std::string& operation, const std::vector<tp_math_utils::Geometry3D>& object, const std::vector<tp_math_utils::Geometry3D>& decoded)
+{
+  if(sameGeometry(object, decoded))
+    return true;
+
+  printf("%s %s does not match the source geometry.\n", config.name.c_str(), operation.c_str());
+  return false;
+}
+
+//##################################################################################################
+//! Build a scene of grid meshes, each with roughly config.verts vertices.
+std::vector<tp_math_utils::Geometry3D> makeScene(const BenchConfig& config)
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+  size_t w = 2;
+  while(w*w < config.verts)
+    w++;
+
+  std::vector<tp_math_utils::Geometry3D> object(config.meshes);
+  for(size_t m=0; m<object.size(); m++)
+  {
+    auto& mesh = object.at(m);
+    mesh.comments.push_back("mesh " + std::to_string(m));
+
+    mesh.verts.resize(w*w);
+    for(size_t y=0; y<w; y++)
+    {
+      for(size_t x=0; x<w; x++)
+      {
+        auto& vert = mesh.verts.at(y*w+x);
+        vert.vert    = {float(x), float(y), dist(rng)};
+        vert.texture = {float(x)/float(w), float(y)/float(w)};
+        vert.normal  = {dist(rng), dist(rng), 1.0f};
+      }
+    }
+
+    if(config.strips)
+    {
+      // One strip per row.
+      for(size_t y=0; y+1<w; y++)
+      {
+        auto& indexes = mesh.indexes.emplace_back();
+        indexes.type = mesh.triangleStrip;
+        for(size_t x=0; x<w; x++)
+        {
+          indexes.indexes.push_back(int(y*w+x));
+          indexes.indexes.push_back(int((y+1)*w+x));
+        }
+      }
+    }
+    else
+    {
+      auto& indexes = mesh.indexes.emplace_back();
+      indexes.type = mesh.triangles;
+      for(size_t y=0; y+1<w; y++)
+      {
+        for(size_t x=0; x+1<w; x++)
+        {
+          int i = int(y*w+x);
+          int s = int(w);
+          for(int index : {i, i+1, i+s, i+1, i+s+1, i+s})
+            indexes.indexes.push_back(index);
+        }
+      }
+    }
+
+    size_t materialIndex = m % std::max(config.materials, size_t(1));
+    mesh.material.name = "material_" + std::to_string(materialIndex);
+    auto openGLMaterial = mesh.material.findOrAddOpenGL();
+    openGLMaterial->albedo = {float(materialIndex%7)/7.0f, 0.5f, 0.25f};
+    openGLMaterial->roughness = float(materialIndex%5)/5.0f;
+
+    if(config.texturesPerMaterial>0)
+      openGLMaterial->albedoTexture = "albedo_" + std::to_string(materialIndex);
+    if(config.texturesPerMaterial>1)
+      openGLMaterial->normalsTexture = "normals_" + std::to_string(materialIndex);
+    if(config.texturesPerMaterial>2)
+      openGLMaterial->roughnessTexture = "roughness_" + std::to_string(materialIndex);
+  }
+
+  return object;
+}
+
+//##################################################################################################
+//! Write an object in one of the legacy formats, this mirrors the version checks in
+//! ReadBOJPrivate.h.
+/*!
+Only used to produce fixtures for the legacy decode paths, material values are placeholders.
+*/
+std::string writeLegacy(const std::vector<tp_math_utils::Geometry3D>& object, uint32_t version)
+{
+  std::string result;
+  auto addInt    = [&](uint32_t n){result.append(reinterpret_cast<const char*>(&n), 4);};
+  auto addFloat  = [&](float n){result.append(reinterpret_cast<const char*>(&n), 4);};
+  auto addFloats = [&](size_t count){for(size_t i=0; i<count; i++) addFloat(0.5f);};
+  auto addInts   = [&](size_t count){for(size_t i=0; i<count; i++) addInt(1);};
+  auto addString = [&](const std::string& s){addInt(uint32_t(s.size())); result+=s;};
+
+  if(version>0)
+    addInt(uint32_t(0)-version);
+  addInt(uint32_t(object.size()));
+
+  for(const auto& mesh : object)
+  {
+    addInt(uint32_t(mesh.comments.size()));
+    for(const auto& comment : mesh.comments)
+      addString(comment);
+
+    addInt(uint32_t(mesh.verts.size()));
+    for(const auto& vert : mesh.verts)
+    {
+      addFloat(vert.vert.x);
+      addFloat(vert.vert.y);
+      addFloat(vert.vert.z);
+
+      if(version<18)
+        addFloats(4); // color
+
+      addFloat(vert.texture.x);
+      addFloat(vert.texture.y);
+
+      addFloat(vert.normal.x);
+      addFloat(vert.normal.y);
+      addFloat(vert.normal.z);
+
+      if(version<4)
+        addFloats(6);
+    }
+
+    addInt(uint32_t(mesh.indexes.size()));
+    for(const auto& indexes : mesh.indexes)
+    {
+      addInt(indexes.type==mesh.triangleFan?1:indexes.type==mesh.triangleStrip?2:3);
+      addInt(uint32_t(indexes.indexes.size()));
+      for(int index : indexes.indexes)
+        addInt(uint32_t(index));
+    }
+
+    addString(mesh.material.name.toString());
+
+    if(version>=20)
+    {
+      nlohmann::json j;
+      mesh.material.saveState(j);
+      addString(j.dump());
+      addFloats(7); // uvTransformation
+      continue;
+    }
+
+    if(version>16)
+      addInt(1); // shaderType
+
+    addFloats(3); // albedo
+    if(version<3)
+      addFloats(3);
+    if(version<6)
+      addFloats(3); // specular
+    if(version<3)
+      addFloats(1);
+    addFloats(1); // alpha
+
+    if(version>2)
+    {
+      addFloats(2); // roughness, metalness
+      if(version>4)
+      {
+        addFloats(version>7?2:1); // transmission
+        addFloats(1); // ior
+        if(version>6)
+        {
+          addFloats(4); // sheen, clear coat
+          if(version>9)
+            addFloats(version>10?4:3); // iridescence, specular
+        }
+
+        addFloats(4); // sss scale and radius
+        if(version>11)
+        {
+          if(version>15)
+          {
+            addInt(1); // sssMethod
+            addFloats(1); // normalStrength
+          }
+          addFloats(7); // albedo adjustments
+        }
+
+        addFloats(7); // sss, emission
+        if(version>6)
+          addFloats(4); // velvet
+        if(version>5)
+          addFloats(2); // height
+      }
+      addFloats(7); // use flags
+    }
+
+    if(version>0)
+    {
+      if(version<3)
+        addFloats(1);
+      addFloats(1); // albedoScale
+      if(version<6)
+        addFloats(1); // specularScale
+    }
+
+    if(version>1)
+    {
+      addInt(1); // tileTextures
+      if(version>12)
+      {
+        addFloats(7); // uvTransformation
+        if(version>13)
+          addInts(version>14?7:6); // ray visibility
+      }
+    }
+
+    size_t textures = 3;
+    if(version<3)
+      textures += 1;
+    if(version<6)
+      textures += 1;
+    if(version>2)
+      textures += version<6?3:5;
+    if(version>6)
+      textures += 8;
+    if(version>8)
+      textures += 4;
+    if(version>10)
+      textures += 1;
+    if(version>18)
+      textures += 2;
+
+    for(size_t i=0; i<textures; i++)
+      addString("texture_" + std::to_string(i));
+  }
+
+  return result;
+}
+
+//##################################################################################################
+//! Returns false if any of the files that were written did not read back as the source geometry.
+bool benchmark(const BenchConfig& config)
+{
+  auto object = makeScene(config);
+
+  std::string data;
+  double seconds = bestTime(config.iterations, [&]
+  {
+    data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, config.writeOptions);
+  });
+  report(config.name, "serialize", data.size(), object.size(), seconds);
+
+  std::vector<tp_math_utils::Geometry3D> decoded;
+  seconds = bestTime(config.iterations, [&]
+  {
+    decoded = tp_boj::deserializeObject(data.data(), data.size(), config.readOptions);
+  });
+  report(config.name, "deserialize", data.size(), object.size(), seconds);
+  bool ok = checkRoundTrip(config, "deserialize", object, decoded);
+  decoded.clear();
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::deserializeRenderMeshes(data.data(), data.size(), config.readOptions, tp_boj::RenderReadOptions());
+  });
+  report(config.name, "render", data.size(), object.size(), seconds);
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::writeObjectAndResourcesToFile(object, filePath, [](const auto&, const auto&){}, [](const auto&, const auto&, const auto&){}, {}, config.writeOptions);
+  });
+  report(config.name, "write file", data.size(), object.size(), seconds);
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+    decoded = tp_boj::readObjectAndTexturesFromFile(filePath, texturePaths, {}, config.readOptions);
+  });
+  report(config.name, "read file", data.size(), object.size(), seconds);
+  ok = checkRoundTrip(config, "read file", object, decoded) && ok;
+  decoded.clear();
+
+  // Opening a view only walks the structure, the geometry is used in place.
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::BOJView view(filePath);
+  });
+  report(config.name, "open view", data.size(), object.size(), seconds);
+
+  {
+    tp_boj::BOJView view(filePath);
+    decoded.resize(view.meshCount());
+    for(size_t m=0; m<decoded.size(); m++)
+      view.decode(m, 0, decoded.at(m));
+    ok = checkRoundTrip(config, "view decode", object, decoded) && ok;
+    decoded.clear();
+  }
+
+  // Patches append a small chunk rather than rewriting the file, compare these with write file.
+  size_t patch=0;
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::BOJPatcher patcher(filePath);
+    patcher.setMeshComments(0, {"patch " + std::to_string(patch++)});
+  });
+  report(config.name, "patch comment", data.size(), object.size(), seconds);
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_math_utils::Material material = object.front().material;
+    material.uvTransformation.rotateUV = float(patch++);
+    tp_boj::BOJPatcher patcher(filePath);
+    patcher.setMaterial(0, material);
+  });
+  report(config.name, "patch material", data.size(), object.size(), seconds);
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::BOJPatcher(filePath).compact();
+  });
+  report(config.name, "compact", data.size(), object.size(), seconds);
+
+  // Only the header is read so this is reported against the size of the whole file.
+  seconds = bestTime(config.iterations, [&]
+  {
+    tp_boj::BOJInfo info;
+    tp_boj::readBOJInfo(filePath, info);
+  });
+  report(config.name, "read info", data.size(), object.size(), seconds);
+
+  std::remove(filePath.c_str());
+  return ok;
+}
+
+//##################################################################################################
+//! Compare reading many files one at a time against reading them with a BatchReader.
+void benchmarkBatch(const BenchConfig& config, size_t fileCount)
+{
+  auto object = makeScene(config);
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, config.writeOptions);
+
+  std::vector<std::string> filePaths;
+  for(size_t i=0; i<fileCount; i++)
+  {
+    filePaths.push_back(filePath + "." + std::to_string(i));
+    tp_boj::writeObjectAndResourcesToFile(object, filePaths.back(), [](const auto&, const auto&){}, [](const auto&, const auto&, const auto&){}, {}, config.writeOptions);
+  }
+
+  size_t bytes = data.size()*fileCount;
+  size_t meshes = object.size()*fileCount;
+
+  double seconds = bestTime(config.iterations, [&]
+  {
+    std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+    for(const auto& path : filePaths)
+      tp_boj::readObjectAndTexturesFromFile(path, texturePaths, {}, config.readOptions);
+  });
+  report(config.name, "read files", bytes, meshes, seconds);
+
+  seconds = bestTime(config.iterations, [&]
+  {
+    // Results are dropped as they load, the same as the loop above, so only loading is measured.
+    tp_boj::BatchReader reader({});
+    for(const auto& path : filePaths)
+      reader.load(path, [](tp_boj::BatchReadResult&){});
+    reader.wait();
+  });
+  report(config.name, "batch read", bytes, meshes, seconds);
+
+  for(const auto& path : filePaths)
+    std::remove(path.c_str());
+}
+
+//##################################################################################################
+//! Compare reading the full resolution meshes against reading a coarser generated LOD, returns
+//! false if the full resolution meshes did not read back as the source geometry.
+bool benchmarkLODs(const BenchConfig& config, size_t lods)
+{
+  auto object = makeScene(config);
+
+  tp_boj::WriteOptions writeOptions = config.writeOptions;
+  writeOptions.generateLODs = lods;
+
+  std::string data;
+  double seconds = bestTime(config.iterations, [&]
+  {
+    data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+  });
+  report(config.name, "serialize", data.size(), object.size(), seconds);
+
+  bool ok=true;
+  for(size_t lod=0; lod<=lods; lod++)
+  {
+    tp_boj::ReadOptions readOptions = config.readOptions;
+    readOptions.lod = lod;
+    std::vector<tp_math_utils::Geometry3D> decoded;
+    seconds = bestTime(config.iterations, [&]
+    {
+      decoded = tp_boj::deserializeObject(data.data(), data.size(), readOptions);
+    });
+    report(config.name, "read lod " + std::to_string(lod), data.size(), object.size(), seconds);
+
+    if(lod==0)
+      ok = checkRoundTrip(config, "read lod 0", object, decoded);
+  }
+
+  return ok;
+}
+
+//##################################################################################################
+//! Decode fixtures written in legacy formats, returns false if any of them fail to decode.
+bool benchmarkLegacy(const BenchConfig& config)
+{
+  auto object = makeScene(config);
+
+  bool ok=true;
+  for(uint32_t version : {3, 6, 17, 19})
+  {
+    std::string data = writeLegacy(object, version);
+
+    std::vector<tp_math_utils::Geometry3D> decoded;
+    double seconds = bestTime(config.iterations, [&]
+    {
+      decoded = tp_boj::deserializeObject(data);
+    });
+    report(config.name + " v" + std::to_string(version), "deserialize", data.size(), object.size(), seconds);
+
+    bool same = decoded.size() == object.size();
+    for(size_t m=0; same && m<object.size(); m++)
+    {
+      const auto& a = object.at(m);
+      const auto& b = decoded.at(m);
+      same = a.verts.size() == b.verts.size() &&
+          a.indexes.size() == b.indexes.size() &&
+          a.material.name == b.material.name &&
+          (a.verts.empty() || a.verts.back().vert == b.verts.back().vert);
+    }
+
+    if(!same)
+    {
+      printf("Legacy version %u failed to decode.\n", version);
+      ok=false;
+    }
+  }
+
+  return ok;
+}
+
+//##################################################################################################
+bool parseArg(const char* arg, const char* name, size_t& value)
+{
+  size_t n = strlen(name);
+  if(strncmp(arg, name, n)!=0 || arg[n]!='=')
+    return false;
+  value = size_t(std::stoull(arg+n+1));
+  return true;
+}
+
+//##################################################################################################
+void printUsage()
+{
+  printf("Usage: tp_boj_bench [options]\n"
+         "  With no scene options a default set of scenes is run.\n"
+         "  --meshes=N      Number of meshes.\n"
+         "  --verts=N       Vertices per mesh.\n"
+         "  --strips        Use triangle strips rather than triangle lists.\n"
+         "  --materials=N   Number of distinct materials.\n"
+         "  --textures=N    Textures per material, 0 to 3.\n"
+         "  --iterations=N  Runs per measurement, the fastest is reported.\n"
+         "  --threads=N     Read and write threads, 0 for one per core.\n"
+         "  --compress      Compress vertex and index chunks.\n"
+         "  --delta         Delta encode indexes.\n"
+         "  --file=PATH     Temporary file used by the file benchmarks.\n");
+}
+}
+
+//##################################################################################################
+int main(int argc, const char** argv)
+{
+  BenchConfig custom;
+  custom.name = "custom";
+  bool useCustom=false;
+
+  for(int i=1; i<argc; i++)
+  {
+    const char* arg = argv[i];
+    size_t value=0;
+
+    if(parseArg(arg, "--meshes", custom.meshes) ||
+       parseArg(arg, "--verts", custom.verts) ||
+       parseArg(arg, "--materials", custom.materials) ||
+       parseArg(arg, "--textures", custom.texturesPerMaterial))
+      useCustom=true;
+    else if(strcmp(arg, "--strips")==0)
+      useCustom = custom.strips = true;
+    else if(parseArg(arg, "--iterations", custom.iterations))
+      custom.iterations = std::max(custom.iterations, size_t(1));
+    else if(parseArg(arg, "--threads", value))
+      custom.readOptions.maxThreads = custom.writeOptions.maxThreads = value;
+    else if(strcmp(arg, "--compress")==0)
+      custom.writeOptions.compress = true;
+    else if(strcmp(arg, "--delta")==0)
+      custom.writeOptions.deltaIndexes = true;
+    else if(strncmp(arg, "--file=", 7)==0)
+      filePath = arg+7;
+    else
+    {
+      printUsage();
+      return strcmp(arg, "--help")==0?0:1;
+    }
+  }
+
+  std::vector<BenchConfig> configs;
+  if(useCustom)
+    configs.push_back(custom);
+  else
+  {
+    auto add = [&](const std::string& name, size_t meshes, size_t verts, bool strips, size_t materials)
+    {
+      auto& config = configs.emplace_back(custom);
+      config.name = name;
+      config.meshes = meshes;
+      config.verts = verts;
+      config.strips = strips;
+      config.materials = materials;
+    };
+
+    add("many small meshes",  5000,    100, false, 500);
+    add("few large meshes",      8, 250000, false,   8);
+    add("strips",              200,  10000, true,   20);
+    add("shared materials",   2000,   1000, false,   2);
+  }
+
+  bool ok=true;
+  for(const auto& config : configs)
+    ok = benchmark(config) && ok;
+
+  BenchConfig batch = custom;
+  batch.name = "batch of 200 files";
+  batch.meshes = 20;
+  batch.verts = 2000;
+  batch.materials = 4;
+  benchmarkBatch(batch, 200);
+
+  BenchConfig lods = custom;
+  lods.name = "lods";
+  lods.meshes = 50;
+  lods.verts = 20000;
+  lods.materials = 5;
+  ok = benchmarkLODs(lods, 3) && ok;
+
+  BenchConfig legacy = custom;
+  legacy.name = "legacy";
+  legacy.meshes = 200;
+  legacy.verts = 2000;
+  legacy.materials = 20;
+
+  ok = benchmarkLegacy(legacy) && ok;
+  return ok?0:1;
+}
@@ -0,0 +1,4 @@
+TARGET = tp_boj_bench
+TEMPLATE = app
+
+SOURCES += src/main.cpp
@@ -0,0 +1,1165 @@
+#include "tp_boj/Compression.h"
+#include "tp_boj/WriteBOJ.h"
+#include "tp_boj/ReadBOJ.h"
+#include "tp_boj/OptimizeMesh.h"
+#include "tp_boj/BatchReadBOJ.h"
+#include "tp_boj/ModelCache.h"
+#include "tp_boj/BOJInfo.h"
+#include "tp_boj/BOJView.h"
+#include "tp_boj/PatchBOJ.h"
+
+#include "tp_math_utils/materials/OpenGLMaterial.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//##################################################################################################
+size_t failures=0;
+
+//##################################################################################################
+void check(bool ok, const std::string& name)
+{
+  if(!ok)
+  {
+    printf("FAIL: %s\n", name.c_str());
+    failures++;
+  }
+}
+
+//##################################################################################################
+//! A grid of triangles in a random order, the worst case for the vertex cache.
+tp_math_utils::Geometry3D scrambledGrid(size_t w, uint32_t seed)
+{
+  tp_math_utils::Geometry3D mesh;
+  for(size_t y=0; y<w; y++)
+  {
+    for(size_t x=0; x<w; x++)
+    {
+      auto& vert = mesh.verts.emplace_back();
+      vert.vert   = {float(x), float(y), float((x*7+y*3)%5)*0.1f};
+      vert.normal = {0.0f, 0.0f, 1.0f};
+    }
+  }
+
+  std::vector<std::array<int, 3>> triangles;
+  for(size_t y=0; y+1<w; y++)
+  {
+    for(size_t x=0; x+1<w; x++)
+    {
+      int i = int(y*w+x);
+      int s = int(w);
+      triangles.push_back({i, i+1, i+s});
+      triangles.push_back({i+1, i+s+1, i+s});
+    }
+  }
+
+  std::mt19937 rng(seed);
+  std::shuffle(triangles.begin(), triangles.end(), rng);
+
+  auto& indexes = mesh.indexes.emplace_back();
+  indexes.type = mesh.triangles;
+  for(const auto& triangle : triangles)
+    for(int i : triangle)
+      indexes.indexes.push_back(i);
+
+  return mesh;
+}
+
+//##################################################################################################
+//! A grid with one strip per row, a fan, and a triangle list with an incomplete triangle at the end.
+tp_math_utils::Geometry3D mixedGrid(size_t w)
+{
+  tp_math_utils::Geometry3D mesh = scrambledGrid(w, 7);
+  mesh.indexes.front().indexes.push_back(0);
+
+  for(size_t y=0; y+1<w; y++)
+  {
+    auto& strip = mesh.indexes.emplace_back();
+    strip.type = mesh.triangleStrip;
+    for(size_t x=0; x<w; x++)
+    {
+      strip.indexes.push_back(int(y*w+x));
+      strip.indexes.push_back(int((y+1)*w+x));
+    }
+  }
+
+  auto& fan = mesh.indexes.emplace_back();
+  fan.type = mesh.triangleFan;
+  for(size_t x=0; x<w; x++)
+    fan.indexes.push_back(int(x));
+
+  auto& shortStrip = mesh.indexes.emplace_back();
+  shortStrip.type = mesh.triangleStrip;
+  shortStrip.indexes = {0, 1};
+
+  return mesh;
+}
+
+//##################################################################################################
+//! A few meshes with every index type, comments, and a material that is shared.
+std::vector<tp_math_utils::Geometry3D> testObject()
+{
+  std::vector<tp_math_utils::Geometry3D> object{mixedGrid(9), scrambledGrid(6, 3), mixedGrid(4)};
+  object.at(0).comments = {"first", "mixed"};
+  object.at(0).material.name = "a";
+  object.at(1).material.name = "b";
+  object.at(2).material.name = "a";
+
+  // Texture coordinates so that every vertex attribute is checked.
+  for(auto& mesh : object)
+    for(auto& vert : mesh.verts)
+      vert.texture = {vert.vert.x*0.5f, vert.vert.y*0.25f};
+
+  return object;
+}
+
+//##################################################################################################
+//! Returns true if the meshes have the same comments, material name, vertices, and indexes.
+bool sameObject(const std::vector<tp_math_utils::Geometry3D>& a, const std::vector<tp_math_utils::Geometry3D>& b)
+{
+  if(a.size()!=b.size())
+    return false;
+
+  for(size_t m=0; m<a.size(); m++)
+  {
+    const auto& x = a.at(m);
+    const auto& y = b.at(m);
+    if(x.comments!=y.comments || x.material.name!=y.material.name || x.verts.size()!=y.verts.size() || x.indexes.size()!=y.indexes.size())
+      return false;
+
+    for(size_t v=0; v<x.verts.size(); v++)
+    {
+      const auto& p = x.verts.at(v);
+      const auto& q = y.verts.at(v);
+      if(p.vert!=q.vert || p.texture!=q.texture || p.normal!=q.normal)
+        return false;
+    }
+
+    for(size_t i=0; i<x.indexes.size(); i++)
+      if(x.indexes.at(i).type!=y.indexes.at(i).type || x.indexes.at(i).indexes!=y.indexes.at(i).indexes)
+        return false;
+  }
+
+  return true;
+}
+
+//##################################################################################################
+//! Read data in each of the ways that the library supports and check that it matches object.
+void checkRead(const std::string& data, const std::vector<tp_math_utils::Geometry3D>& object, const std::string& name)
+{
+  check(sameObject(tp_boj::deserializeObject(data), object), name + " read");
+
+  for(size_t maxThreads : {size_t(1), size_t(4)})
+  {
+    std::string threads = std::to_string(maxThreads);
+    tp_boj::ReadOptions readOptions;
+    readOptions.maxThreads = maxThreads;
+    check(sameObject(tp_boj::deserializeObject(data.data(), data.size(), readOptions), object), name + " read threads " + threads);
+
+    std::vector<tp_math_utils::Geometry3D> streamed;
+    bool ok = tp_boj::deserializeObject(data.data(), data.size(), readOptions, [&](tp_math_utils::Geometry3D& mesh)
+    {
+      streamed.push_back(std::move(mesh));
+      return true;
+    });
+    check(ok && sameObject(streamed, object), name + " read streamed threads " + threads);
+  }
+
+  tp_boj::BOJView view(data.data(), data.size());
+  std::vector<tp_math_utils::Geometry3D> viewed(view.meshCount());
+  bool decoded = view.isValid();
+  for(size_t m=0; m<viewed.size() && decoded; m++)
+    decoded = view.decode(m, 0, viewed.at(m));
+  check(decoded && sameObject(viewed, object), name + " view");
+}
+
+//##################################################################################################
+void writeFile(const std::string& filePath, const std::string& data)
+{
+  std::ofstream out(filePath, std::ios::binary|std::ios::trunc);
+  out.write(data.data(), std::streamsize(data.size()));
+}
+
+//##################################################################################################
+std::string readFile(const std::string& filePath)
+{
+  std::ifstream in(filePath, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+//##################################################################################################
+tp_math_utils::Geometry3D readLOD(const std::string& data, size_t lod)
+{
+  tp_boj::ReadOptions readOptions;
+  readOptions.lod = lod;
+  auto object = tp_boj::deserializeObject(data.data(), data.size(), readOptions);
+  return object.empty()?tp_math_utils::Geometry3D():object.front();
+}
+
+//##################################################################################################
+void testRoundTrip()
+{
+  std::vector<tp_math_utils::Geometry3D> object = testObject();
+
+  // Every combination of the options that change how the geometry is stored.
+  for(int mode=0; mode<8; mode++)
+  {
+    std::string name = "round trip " + std::to_string(mode);
+    tp_boj::WriteOptions writeOptions;
+    writeOptions.compress = mode&1;
+    writeOptions.deltaIndexes = mode&2;
+    writeOptions.generateLODs = (mode&4)?2:0;
+    std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    checkRead(data, object, name);
+
+    // The sink gets the same bytes in blocks of at most blockSize.
+    tp_boj::WriteOptions blockOptions = writeOptions;
+    blockOptions.blockSize = 1000;
+    std::string streamed;
+    bool blocksFit = true;
+    bool ok = tp_boj::serializeObject(object, [&](const char* d, size_t size)
+    {
+      blocksFit = blocksFit && size<=blockOptions.blockSize;
+      streamed.append(d, size);
+      return true;
+    }, [](const auto&){}, [](const auto&, const auto&){}, {}, blockOptions);
+    check(ok && blocksFit && streamed==data, name + " streamed");
+
+    // The output doesn't depend on the number of threads.
+    tp_boj::WriteOptions threadOptions = writeOptions;
+    threadOptions.maxThreads = 4;
+    check(tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, threadOptions)==data, name + " write threads");
+  }
+
+  {
+    std::vector<tp_math_utils::Geometry3D> large{scrambledGrid(100, 1)};
+    tp_boj::WriteOptions writeOptions;
+    std::string plain = tp_boj::serializeObject(large, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    writeOptions.compress = true;
+    std::string compressed = tp_boj::serializeObject(large, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    check(compressed.size() < plain.size(), "round trip compressed size");
+  }
+}
+
+//##################################################################################################
+void testSelectiveReads()
+{
+  std::vector<tp_math_utils::Geometry3D> object = testObject();
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  for(size_t maxThreads : {size_t(1), size_t(4)})
+  {
+    std::string threads = std::to_string(maxThreads);
+
+    tp_boj::ReadOptions indexOptions;
+    indexOptions.maxThreads = maxThreads;
+    indexOptions.meshIndexFilter = [](size_t m){return m!=1;};
+    auto meshes = tp_boj::deserializeObject(data.data(), data.size(), indexOptions);
+    check(sameObject(meshes, {object.at(0), object.at(2)}), "selective mesh index " + threads);
+
+    tp_boj::ReadOptions materialOptions;
+    materialOptions.maxThreads = maxThreads;
+    materialOptions.materialFilter = [](const tp_utils::StringID& name){return name.toString()=="b";};
+    meshes = tp_boj::deserializeObject(data.data(), data.size(), materialOptions);
+    check(sameObject(meshes, {object.at(1)}), "selective material " + threads);
+
+    // Without geometry only the comments and materials are read.
+    tp_boj::ReadOptions geometryOptions;
+    geometryOptions.maxThreads = maxThreads;
+    geometryOptions.loadGeometry = false;
+    std::vector<tp_math_utils::Geometry3D> expected = object;
+    for(auto& mesh : expected)
+    {
+      mesh.verts.clear();
+      mesh.indexes.clear();
+    }
+    check(sameObject(tp_boj::deserializeObject(data.data(), data.size(), geometryOptions), expected), "selective no geometry " + threads);
+  }
+}
+
+//##################################################################################################
+//! Compress and decompress data, returns true if the result matches.
+bool roundTrip(const std::string& data)
+{
+  std::string compressed = tp_boj::compressChunk(data.data(), data.size());
+
+  // Fill the output so that bytes the decoder fails to write are noticed.
+  std::string output(data.size(), '\xAA');
+  if(!tp_boj::decompressChunk(compressed.data(), compressed.size(), output.data(), output.size()))
+    return false;
+
+  return output == data;
+}
+
+//##################################################################################################
+std::string randomBytes(size_t size, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::string data(size, '\0');
+  for(auto& c : data)
+    c = char(rng());
+  return data;
+}
+
+//##################################################################################################
+//! Floats on a grid, these are what vertex chunks mostly look like.
+std::string gridFloats(size_t count)
+{
+  std::string data;
+  for(size_t i=0; i<count; i++)
+  {
+    float f = float(i%64)*0.25f;
+    data.append(reinterpret_cast<const char*>(&f), 4);
+  }
+  return data;
+}
+
+//##################################################################################################
+void testCompressionRoundTrip()
+{
+  check(roundTrip(std::string()), "compression empty");
+  check(roundTrip("a"), "compression single byte");
+
+  for(size_t size : {1, 2, 3, 5, 6, 7, 13, 4099, 65537})
+    check(roundTrip(randomBytes(size, uint32_t(size))), "compression incompressible " + std::to_string(size));
+
+  {
+    std::string data = randomBytes(100000, 1);
+    std::string compressed = tp_boj::compressChunk(data.data(), data.size());
+    check(compressed.size() < data.size() + data.size()/100 + 16, "compression incompressible growth");
+  }
+
+  for(size_t size : {4001, 4002, 4003})
+  {
+    std::string data = gridFloats(size/4);
+    data += randomBytes(size%4, 2);
+    check(roundTrip(data), "compression unaligned tail " + std::to_string(size));
+  }
+
+  // Long runs produce matches longer than 15+255 bytes and matches that overlap themselves.
+  {
+    std::string data(1000000, 'x');
+    std::string compressed = tp_boj::compressChunk(data.data(), data.size());
+    check(compressed.size() < data.size()/100, "compression long match size");
+    check(roundTrip(data), "compression long match");
+  }
+
+  {
+    std::string data = gridFloats(100000);
+    std::string compressed = tp_boj::compressChunk(data.data(), data.size());
+    check(compressed.size() < data.size()/4, "compression floats size");
+    check(roundTrip(data), "compression floats");
+  }
+
+  // Repeats just inside and outside of the 64K match window.
+  for(size_t gap : {65535-64, 65535, 65536+64})
+  {
+    std::string block = randomBytes(4096, 3);
+    std::string data = block + randomBytes(gap, 4) + block;
+    check(roundTrip(data), "compression window " + std::to_string(gap));
+  }
+}
+
+//##################################################################################################
+void testCompressionRejectsInvalid()
+{
+  std::string data = gridFloats(10000) + randomBytes(3, 5);
+  std::string compressed = tp_boj::compressChunk(data.data(), data.size());
+  std::string output(data.size(), '\0');
+
+  auto decompress = [&](const std::string& c, size_t outputSize)
+  {
+    output.resize(outputSize);
+    return tp_boj::decompressChunk(c.data(), c.size(), output.data(), output.size());
+  };
+
+  check(decompress(compressed, data.size()), "decompress valid");
+  check(!decompress(std::string(), data.size()), "decompress empty input");
+  check(!decompress(compressed, data.size()-1), "decompress short output");
+  check(!decompress(compressed, data.size()+1), "decompress long output");
+
+  for(size_t size=0; size<compressed.size(); size++)
+    if(decompress(compressed.substr(0, size), data.size()))
+      check(false, "decompress truncated " + std::to_string(size));
+
+  // Corrupt each byte in turn, every result must either fail or stay within the output.
+  std::mt19937 rng(6);
+  for(size_t i=0; i<compressed.size(); i++)
+  {
+    std::string corrupt = compressed;
+    corrupt[i] = char(uint8_t(corrupt[i]) ^ uint8_t(1 + rng()%255));
+    decompress(corrupt, data.size());
+  }
+
+  // An offset that points before the start of the output.
+  {
+    std::string bad;
+    bad.push_back(char(0x10)); // One literal then a match.
+    bad.push_back('a');
+    bad.push_back(char(2));
+    bad.push_back(char(0));
+    check(!decompress(bad, 5), "decompress offset before start");
+  }
+
+  // A zero offset.
+  {
+    std::string bad;
+    bad.push_back(char(0x10));
+    bad.push_back('a');
+    bad.push_back(char(0));
+    bad.push_back(char(0));
+    check(!decompress(bad, 5), "decompress zero offset");
+  }
+}
+
+//##################################################################################################
+//! A fan around the first of count vertices and a triangle that spans all of them.
+tp_math_utils::Geometry3D fanMesh(size_t count)
+{
+  tp_math_utils::Geometry3D mesh;
+  mesh.verts.resize(count);
+  for(size_t i=0; i<count; i++)
+    mesh.verts.at(i).vert = {float(i), float(i%7), 0.0f};
+
+  auto& fan = mesh.indexes.emplace_back();
+  fan.type = mesh.triangleFan;
+  for(size_t i=0; i<count; i++)
+    fan.indexes.push_back(int(i));
+
+  auto& triangle = mesh.indexes.emplace_back();
+  triangle.type = mesh.triangles;
+  triangle.indexes = {0, int(count-1), int(count/2)};
+
+  return mesh;
+}
+
+//##################################################################################################
+void testIndexPacking()
+{
+  // Either side of the vertex counts where indexes need 2 and then 4 bytes.
+  for(size_t count : {3, 256, 257, 65536, 65537})
+  {
+    std::vector<tp_math_utils::Geometry3D> object{fanMesh(count)};
+    for(bool deltaIndexes : {false, true})
+    {
+      tp_boj::WriteOptions writeOptions;
+      writeOptions.deltaIndexes = deltaIndexes;
+      std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+      check(sameObject(tp_boj::deserializeObject(data), object), "index packing " + std::to_string(count) + " delta " + std::to_string(deltaIndexes));
+    }
+  }
+
+  // Neighbouring indexes are smaller as deltas than at a fixed width.
+  {
+    std::vector<tp_math_utils::Geometry3D> object{fanMesh(100000)};
+    tp_boj::WriteOptions writeOptions;
+    std::string packed = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    writeOptions.deltaIndexes = true;
+    std::string delta = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    check(delta.size()+200000 < packed.size(), "index packing delta size");
+  }
+}
+
+//##################################################################################################
+void testOptimizeMeshes()
+{
+  std::vector<tp_math_utils::Geometry3D> object{scrambledGrid(30, 4)};
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.optimizeMeshes = true;
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+
+  // The triangles are reordered but there are the same number of them.
+  auto optimized = tp_boj::deserializeObject(data);
+  check(optimized.size()==1, "optimize meshes count");
+  if(optimized.size()==1)
+  {
+    check(tp_boj::countTriangles(optimized.front())==tp_boj::countTriangles(object.front()), "optimize meshes triangles");
+    check(tp_boj::countCacheMisses(optimized.front()) < tp_boj::countCacheMisses(object.front()), "optimize meshes cache misses");
+  }
+
+  // The meshes passed in are not modified.
+  check(sameObject(object, {scrambledGrid(30, 4)}), "optimize meshes input");
+}
+
+//##################################################################################################
+void testSharedMaterials()
+{
+  // Meshes with the same material share a single copy of it.
+  std::vector<tp_math_utils::Geometry3D> shared(10, scrambledGrid(3, 5));
+  for(auto& mesh : shared)
+    mesh.material.name = std::string(1000, 'm');
+
+  std::vector<tp_math_utils::Geometry3D> distinct = shared;
+  for(size_t m=0; m<distinct.size(); m++)
+    distinct.at(m).material.name = std::string(1000, 'm') + std::to_string(m);
+
+  std::string sharedData = tp_boj::serializeObject(shared, [](const auto&){}, [](const auto&, const auto&){}, {});
+  std::string distinctData = tp_boj::serializeObject(distinct, [](const auto&){}, [](const auto&, const auto&){}, {});
+  check(sharedData.size()+9000 < distinctData.size(), "shared materials size");
+  check(sameObject(tp_boj::deserializeObject(sharedData), shared), "shared materials read");
+  check(sameObject(tp_boj::deserializeObject(distinctData), distinct), "distinct materials read");
+}
+
+//##################################################################################################
+void testWriteFile()
+{
+  std::string filePath = (std::filesystem::temp_directory_path() / "tp_boj_test_write.boj").string();
+  std::vector<tp_math_utils::Geometry3D> object{scrambledGrid(20, 4), scrambledGrid(10, 5)};
+
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.compress = true;
+  std::string expected = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+
+  for(bool boundedMemory : {false, true})
+  {
+    writeOptions.boundedMemory = boundedMemory;
+    tp_boj::writeObjectAndResourcesToFile(object, filePath, [](const auto&, const auto&){}, [](const auto&, const auto&, const auto&){}, {}, writeOptions);
+    check(readFile(filePath) == expected, "write file bounded memory " + std::to_string(boundedMemory));
+  }
+
+  // A write that fails leaves the existing file as it was.
+  std::filesystem::create_directory(filePath + ".tmp");
+  tp_boj::writeObjectAndResourcesToFile({object.front()}, filePath, [](const auto&, const auto&){}, [](const auto&, const auto&, const auto&){}, {});
+  check(readFile(filePath) == expected, "write file failure keeps file");
+
+  std::filesystem::remove(filePath + ".tmp");
+  std::filesystem::remove(filePath);
+}
+
+//##################################################################################################
+void testResourceStats()
+{
+  std::vector<tp_math_utils::Geometry3D> object;
+  for(const char* texture : {"a", "b", "c"})
+  {
+    object.push_back(scrambledGrid(4, 6));
+    object.back().material.findOrAddOpenGL()->albedoTexture = texture;
+  }
+
+  auto saveTexture = [](const tp_utils::StringID& texture)
+  {
+    if(texture.toString() == "b")
+      throw std::runtime_error("texture b");
+  };
+
+  // Resources that fail to save are reported but not counted.
+  tp_boj::WriteStats stats;
+  std::vector<std::string> errors;
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.concurrentResources = true;
+  writeOptions.resourceErrors = &errors;
+  writeOptions.stats = &stats;
+  tp_boj::serializeObject(object, saveTexture, [](const auto&, const auto&){}, {}, writeOptions);
+  check(errors.size()==1 && stats.textures==2, "resource stats skip failed textures");
+}
+
+//##################################################################################################
+void testStats()
+{
+  std::vector<tp_math_utils::Geometry3D> object = testObject();
+  size_t verts=0;
+  for(const auto& mesh : object)
+    verts += mesh.verts.size();
+
+  tp_boj::WriteStats writeStats;
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.stats = &writeStats;
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+  check(writeStats.bytes==data.size() && writeStats.meshes==object.size() && writeStats.verts==verts, "write stats");
+  check(writeStats.materials==2, "write stats materials");
+
+  // Meshes rejected by the filters are not counted.
+  tp_boj::ReadStats readStats;
+  tp_boj::ReadOptions readOptions;
+  readOptions.stats = &readStats;
+  readOptions.meshIndexFilter = [](size_t m){return m!=1;};
+  tp_boj::deserializeObject(data.data(), data.size(), readOptions);
+  check(readStats.bytes==data.size() && readStats.meshes==2 && readStats.verts==verts-object.at(1).verts.size(), "read stats");
+}
+
+//##################################################################################################
+void testTruncated()
+{
+  std::string data = tp_boj::serializeObject(testObject(), [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  // Every prefix of the file either reads or fails with an error inside the data, only the padding
+  // at the end of aligned files can be cut without losing anything.
+  for(size_t size=0; size<data.size(); size++)
+  {
+    std::string truncated = data.substr(0, size);
+    tp_boj::ReadError error;
+    tp_boj::ReadOptions readOptions;
+    readOptions.error = &error;
+    bool ok = tp_boj::deserializeObject(truncated.data(), truncated.size(), readOptions, [](tp_math_utils::Geometry3D&){return true;});
+    if(ok?(size+64<data.size()):(error.reason.empty() || error.offset>size))
+      check(false, "truncated " + std::to_string(size));
+  }
+}
+
+//##################################################################################################
+//! Thrown from callbacks to check that it reaches the caller unchanged.
+struct CallbackError
+{
+  int value;
+};
+
+//##################################################################################################
+//! Returns true if fn throws a CallbackError with value.
+template<typename Fn>
+bool throwsCallbackError(const Fn& fn, int value)
+{
+  try
+  {
+    fn();
+  }
+  catch(const CallbackError& e)
+  {
+    return e.value==value;
+  }
+  catch(...)
+  {
+  }
+  return false;
+}
+
+//##################################################################################################
+void testCallbackExceptions()
+{
+  std::vector<tp_math_utils::Geometry3D> object{scrambledGrid(5, 8), scrambledGrid(5, 9), scrambledGrid(5, 10)};
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  for(size_t maxThreads : {1, 3})
+  {
+    std::string threads = std::to_string(maxThreads);
+    tp_boj::ReadError error;
+    tp_boj::ReadOptions readOptions;
+    readOptions.maxThreads = maxThreads;
+    readOptions.error = &error;
+
+    check(throwsCallbackError([&]
+    {
+      tp_boj::deserializeObject(data.data(), data.size(), readOptions, [](tp_math_utils::Geometry3D&)->bool{throw CallbackError{1};});
+    }, 1) && error.reason.empty(), "callback meshDecoded exception " + threads);
+
+    tp_boj::ReadOptions filterOptions = readOptions;
+    filterOptions.meshIndexFilter = [](size_t m){if(m==1) throw CallbackError{2}; return true;};
+    check(throwsCallbackError([&]{tp_boj::deserializeObject(data.data(), data.size(), filterOptions);}, 2) && error.reason.empty(), "callback filter exception " + threads);
+
+    tp_boj::RenderReadOptions renderOptions;
+    renderOptions.allocateIndexes = [](const tp_boj::RenderMesh&)->void*{throw CallbackError{3};};
+    check(throwsCallbackError([&]{tp_boj::deserializeRenderMeshes(data.data(), data.size(), readOptions, renderOptions);}, 3) && error.reason.empty(), "callback allocator exception " + threads);
+
+    // A bad result from a callback is still reported as an error by the library.
+    renderOptions.allocateIndexes = [](const tp_boj::RenderMesh&)->void*{return nullptr;};
+    check(tp_boj::deserializeRenderMeshes(data.data(), data.size(), readOptions, renderOptions).empty() && error.reason=="BOJ allocateIndexes returned null.", "callback allocator null " + threads);
+  }
+}
+
+//##################################################################################################
+void testBatchReader()
+{
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "tp_boj_test_batch";
+  std::filesystem::create_directories(directory);
+
+  std::vector<std::string> filePaths;
+  std::vector<std::vector<tp_math_utils::Geometry3D>> objects;
+  for(uint32_t i=0; i<6; i++)
+  {
+    objects.push_back({scrambledGrid(4+i, i)});
+    filePaths.push_back((directory / (std::to_string(i) + ".boj")).string());
+    writeFile(filePaths.back(), tp_boj::serializeObject(objects.back(), [](const auto&){}, [](const auto&, const auto&){}, {}));
+  }
+  filePaths.push_back((directory / "missing.boj").string());
+
+  tp_boj::BatchReadOptions options;
+  options.maxThreads = 3;
+  options.maxInFlight = 2;
+
+  // Results are returned in the order of the files, files that can't be read are empty.
+  std::unordered_map<tp_utils::StringID, std::string> texturePaths;
+  auto results = tp_boj::readObjectsAndTexturesFromFiles(filePaths, texturePaths, {}, options);
+  check(results.size()==filePaths.size(), "batch count");
+  for(size_t i=0; i<objects.size() && i<results.size(); i++)
+    check(sameObject(results.at(i), objects.at(i)), "batch file " + std::to_string(i));
+  check(results.size()==filePaths.size() && results.back().empty(), "batch missing file");
+
+  {
+    tp_boj::BatchReader reader({}, options);
+    auto found = reader.load(filePaths.front());
+    auto missing = reader.load(filePaths.back());
+    tp_boj::BatchReadResult foundResult = found.get();
+    tp_boj::BatchReadResult missingResult = missing.get();
+    check(foundResult.error.reason.empty() && sameObject(foundResult.object, objects.front()), "batch future");
+    check(!missingResult.error.reason.empty() && missingResult.object.empty(), "batch future missing file");
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+//##################################################################################################
+void testModelCache()
+{
+  std::string filePath = (std::filesystem::temp_directory_path() / "tp_boj_test_model_cache.boj").string();
+  tp_boj::ModelCache cache({});
+
+  // Failed loads are not cached so that the file is read again once it has been fixed.
+  writeFile(filePath, "not a boj file");
+  check(!cache.load(filePath)->error.reason.empty(), "model cache invalid file");
+  check(!cache.load(filePath)->error.reason.empty(), "model cache invalid file again");
+  check(cache.stats().misses==2 && cache.stats().models==0 && cache.stats().bytes==0, "model cache failure not cached");
+
+  tp_math_utils::Geometry3D mesh = scrambledGrid(10, 3);
+  writeFile(filePath, tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}));
+  auto plain = cache.load(filePath);
+  check(plain->error.reason.empty() && plain->object.size()==1, "model cache load");
+  check(cache.stats().models==1 && cache.stats().bytes==plain->bytes, "model cache loaded");
+  check(cache.load(filePath)==plain && cache.stats().hits==1, "model cache hit");
+
+  // A file that has changed since it was cached is read again.
+  writeFile(filePath, tp_boj::serializeObject({mesh, mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}));
+  auto changed = cache.load(filePath);
+  check(changed!=plain && changed->object.size()==2 && cache.stats().models==1, "model cache changed file");
+
+  // Materials count towards the size of a model.
+  mesh.material.name = std::string(1000, 'm');
+  mesh.material.findOrAddOpenGL()->albedoTexture = std::string(1000, 't');
+  writeFile(filePath, tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}));
+  auto textured = cache.load(filePath);
+  check(textured->error.reason.empty(), "model cache load textured");
+  check(textured->bytes >= plain->bytes+1000, "model cache counts materials");
+
+  std::filesystem::remove(filePath);
+}
+
+//##################################################################################################
+void testRenderMeshes()
+{
+  std::vector<tp_math_utils::Geometry3D> object{mixedGrid(12), mixedGrid(5)};
+
+  for(int mode=0; mode<8; mode++)
+  {
+    tp_boj::WriteOptions writeOptions;
+    writeOptions.compress = mode&1;
+    writeOptions.deltaIndexes = mode&2;
+    std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+
+    tp_boj::RenderReadOptions renderOptions;
+    renderOptions.allow16BitIndexes = mode&4;
+    auto meshes = tp_boj::deserializeRenderMeshes(data.data(), data.size(), tp_boj::ReadOptions(), renderOptions);
+    check(meshes.size()==object.size(), "render meshes count " + std::to_string(mode));
+
+    for(size_t m=0; m<meshes.size() && m<object.size(); m++)
+    {
+      std::vector<uint32_t> expected;
+      for(const auto& index : object.at(m).indexes)
+        tp_boj::forEachTriangle(object.at(m), index, [&](int a, int b, int c){expected.insert(expected.end(), {uint32_t(a), uint32_t(b), uint32_t(c)});});
+
+      const auto& mesh = meshes.at(m);
+      std::vector<uint32_t> indexes = mesh.indexes32;
+      if(mesh.indexSize==2)
+        indexes.assign(mesh.indexes16.begin(), mesh.indexes16.end());
+      check(mesh.indexSize==((mode&4)?2u:4u), "render meshes index size " + std::to_string(mode));
+      check(mesh.indexCount==expected.size() && indexes==expected, "render meshes indexes " + std::to_string(mode));
+    }
+  }
+
+  // Vertices are written in the requested layout.
+  {
+    std::vector<tp_math_utils::Geometry3D> object = testObject();
+    std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+    for(auto layout : {tp_boj::RenderVertexLayout::Interleaved, tp_boj::RenderVertexLayout::SoA})
+    {
+      std::string name = (layout==tp_boj::RenderVertexLayout::SoA)?"soa":"interleaved";
+      tp_boj::RenderReadOptions renderOptions;
+      renderOptions.vertexLayout = layout;
+      auto meshes = tp_boj::deserializeRenderMeshes(data.data(), data.size(), tp_boj::ReadOptions(), renderOptions);
+      check(meshes.size()==object.size(), "render meshes count " + name);
+
+      for(size_t m=0; m<meshes.size() && m<object.size(); m++)
+      {
+        const auto& mesh = meshes.at(m);
+        const auto& verts = object.at(m).verts;
+        bool same = mesh.meshIndex==m && mesh.comments==object.at(m).comments && mesh.material.name==object.at(m).material.name && mesh.vertexCount==verts.size();
+        for(size_t v=0; v<verts.size() && same; v++)
+        {
+          const auto& vert = verts.at(v);
+          std::array<float, 8> expected{vert.vert.x, vert.vert.y, vert.vert.z, vert.texture.x, vert.texture.y, vert.normal.x, vert.normal.y, vert.normal.z};
+          std::array<float, 8> actual;
+          if(layout==tp_boj::RenderVertexLayout::SoA)
+            actual = {mesh.positions.at(v*3), mesh.positions.at(v*3+1), mesh.positions.at(v*3+2), mesh.textures.at(v*2), mesh.textures.at(v*2+1), mesh.normals.at(v*3), mesh.normals.at(v*3+1), mesh.normals.at(v*3+2)};
+          else
+            std::copy(mesh.interleaved.begin()+ptrdiff_t(v*8), mesh.interleaved.begin()+ptrdiff_t(v*8+8), actual.begin());
+          same = actual==expected;
+        }
+        check(same, "render meshes verts " + name + " " + std::to_string(m));
+      }
+    }
+  }
+
+  // Indexes past the last vertex are rejected rather than passed on to the caller's buffers.
+  for(int index : {5*5, -1})
+  {
+    tp_math_utils::Geometry3D mesh = mixedGrid(5);
+    mesh.indexes.front().indexes.at(4) = index;
+
+    for(bool deltaIndexes : {false, true})
+    {
+      tp_boj::WriteOptions writeOptions;
+      writeOptions.deltaIndexes = deltaIndexes;
+      std::string data = tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+
+      tp_boj::ReadError error;
+      tp_boj::ReadOptions readOptions;
+      readOptions.error = &error;
+      tp_boj::RenderReadOptions renderOptions;
+      renderOptions.allow16BitIndexes = true;
+      auto meshes = tp_boj::deserializeRenderMeshes(data.data(), data.size(), readOptions, renderOptions);
+      check(meshes.empty() && error.reason=="BOJ index out of range." && error.meshIndex==0, "render meshes index out of range " + std::to_string(index));
+    }
+  }
+}
+
+//##################################################################################################
+void testBOJInfo()
+{
+  std::vector<tp_math_utils::Geometry3D> object = testObject();
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  tp_boj::BOJInfo info;
+  check(tp_boj::readBOJInfo(data.data(), data.size(), info) && info.fromHeader, "info read");
+  check(info.meshCount==object.size() && info.meshes.size()==object.size(), "info mesh count");
+
+  size_t verts=0;
+  for(size_t m=0; m<object.size() && m<info.meshes.size(); m++)
+  {
+    tp_boj::Bounds expected = tp_boj::calculateBounds(object.at(m));
+    const tp_boj::Bounds& bounds = info.meshes.at(m);
+    check(bounds.min==expected.min && bounds.max==expected.max && bounds.radius==expected.radius, "info bounds " + std::to_string(m));
+    check(bounds.verts==expected.verts && bounds.triangles==expected.triangles, "info counts " + std::to_string(m));
+    verts += object.at(m).verts.size();
+  }
+  check(info.total.verts==verts && info.total.max==tp_boj::combineBounds(info.meshes).max, "info total");
+
+  // Only the header is needed.
+  tp_boj::BOJInfo headerInfo;
+  check(tp_boj::readBOJInfo(data.data(), data.size()/2, headerInfo) && headerInfo.meshes.size()==object.size(), "info header only");
+
+  tp_boj::ReadError error;
+  check(!tp_boj::readBOJInfo(data.data(), 10, headerInfo, &error) && !error.reason.empty(), "info truncated header");
+}
+
+//##################################################################################################
+void testLODs()
+{
+  tp_math_utils::Geometry3D mesh = scrambledGrid(8, 1);
+  mesh.comments = {"lods"};
+  mesh.material.name = "l";
+  std::vector<std::vector<tp_math_utils::Geometry3D>> lods{{scrambledGrid(4, 2), scrambledGrid(2, 3)}};
+
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.lods = &lods;
+  std::string data = tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+
+  // Each level shares the comments and material of the mesh.
+  std::vector<tp_math_utils::Geometry3D> levels{mesh, lods.front().at(0), lods.front().at(1)};
+  for(auto& level : levels)
+  {
+    level.comments = mesh.comments;
+    level.material = mesh.material;
+  }
+
+  for(size_t lod=0; lod<4; lod++)
+    check(sameObject({readLOD(data, lod)}, {levels.at(std::min(lod, size_t(2)))}), "lod " + std::to_string(lod));
+
+  // Progressive reads start with the coarsest level and refine down to options.lod.
+  std::vector<size_t> order;
+  tp_boj::ReadOptions readOptions;
+  readOptions.lod = 1;
+  bool ok = tp_boj::deserializeObjectProgressive(data.data(), data.size(), readOptions, [&](size_t meshIndex, size_t lod, tp_math_utils::Geometry3D& level)
+  {
+    order.push_back(lod);
+    check(meshIndex==0 && sameObject({level}, {levels.at(lod)}), "lod progressive " + std::to_string(lod));
+    return true;
+  });
+  check(ok && order==std::vector<size_t>{2, 1}, "lod progressive order");
+}
+
+//##################################################################################################
+void testOptimizedLODs()
+{
+  tp_math_utils::Geometry3D mesh = scrambledGrid(60, 1);
+  tp_math_utils::Geometry3D coarse = scrambledGrid(30, 2);
+
+  tp_math_utils::Geometry3D optimizedCoarse = coarse;
+  tp_boj::optimizeMesh(optimizedCoarse);
+  size_t expectedMisses = tp_boj::countCacheMisses(optimizedCoarse);
+  check(expectedMisses < tp_boj::countCacheMisses(coarse), "optimize scrambled grid");
+
+  // Supplied LODs are optimized along with the mesh.
+  {
+    std::vector<std::vector<tp_math_utils::Geometry3D>> lods{{coarse}};
+    tp_boj::WriteOptions writeOptions;
+    writeOptions.optimizeMeshes = true;
+    writeOptions.lods = &lods;
+
+    std::string data = tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    tp_math_utils::Geometry3D lod = readLOD(data, 1);
+    check(tp_boj::countTriangles(lod) == tp_boj::countTriangles(coarse), "optimized supplied lod triangles");
+    check(tp_boj::countCacheMisses(lod) == expectedMisses, "optimized supplied lod cache misses");
+
+    std::string streamed;
+    tp_boj::serializeObject({mesh}, [&](const char* d, size_t size){streamed.append(d, size); return true;}, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    check(streamed == data, "optimized supplied lod streamed");
+  }
+
+  // Generated LODs are optimized after they are simplified.
+  {
+    tp_boj::WriteOptions writeOptions;
+    writeOptions.optimizeMeshes = true;
+    writeOptions.generateLODs = 1;
+
+    std::string data = tp_boj::serializeObject({mesh}, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+    tp_math_utils::Geometry3D lod = readLOD(data, 1);
+    size_t triangles = tp_boj::countTriangles(lod);
+    check(triangles>0 && triangles < tp_boj::countTriangles(mesh), "optimized generated lod triangles");
+
+    tp_math_utils::Geometry3D optimizedLOD = lod;
+    tp_boj::optimizeMesh(optimizedLOD);
+    check(tp_boj::countCacheMisses(lod) <= tp_boj::countCacheMisses(optimizedLOD), "optimized generated lod cache misses");
+  }
+}
+
+//##################################################################################################
+void testBOJView()
+{
+  std::vector<tp_math_utils::Geometry3D> object = testObject();
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  tp_boj::BOJView view(data.data(), data.size());
+  check(view.isValid() && view.meshCount()==object.size() && view.materialCount()==2, "view open");
+
+  // Uncompressed geometry is used in place.
+  for(size_t m=0; m<object.size() && m<view.meshCount(); m++)
+  {
+    const auto& mesh = object.at(m);
+    const auto& meshView = view.mesh(m);
+    const auto& geometry = meshView.lods.front();
+
+    bool same = view.material(meshView.materialIndex).name==mesh.material.name;
+    same = same && std::vector<std::string>(meshView.comments.begin(), meshView.comments.end())==mesh.comments;
+    same = same && geometry.inPlace && geometry.vertCount==mesh.verts.size() && geometry.indexArrays.size()==mesh.indexes.size();
+    same = same && reinterpret_cast<uintptr_t>(geometry.verts)%64==reinterpret_cast<uintptr_t>(data.data())%64;
+
+    for(size_t v=0; v<mesh.verts.size() && same; v++)
+    {
+      const auto& vert = geometry.verts[v];
+      same = glm::vec3(vert.vert[0], vert.vert[1], vert.vert[2])==mesh.verts.at(v).vert;
+      same = same && glm::vec2(vert.texture[0], vert.texture[1])==mesh.verts.at(v).texture;
+      same = same && glm::vec3(vert.normal[0], vert.normal[1], vert.normal[2])==mesh.verts.at(v).normal;
+    }
+
+    for(size_t i=0; i<mesh.indexes.size() && same; i++)
+    {
+      const auto& indexes = mesh.indexes.at(i).indexes;
+      const auto& arrayView = geometry.indexArrays.at(i);
+      same = arrayView.count==indexes.size();
+      for(size_t j=0; j<indexes.size() && same; j++)
+        same = arrayView[j]==uint32_t(indexes.at(j));
+    }
+
+    check(same, "view mesh " + std::to_string(m));
+  }
+
+  // Compressed geometry has to be decoded.
+  tp_boj::WriteOptions writeOptions;
+  writeOptions.compress = true;
+  std::string compressed = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}, writeOptions);
+  tp_boj::BOJView compressedView(compressed.data(), compressed.size());
+  check(compressedView.isValid() && !compressedView.mesh(0).lods.front().inPlace, "view compressed");
+}
+
+//##################################################################################################
+tp_math_utils::Material namedMaterial(const std::string& name)
+{
+  tp_math_utils::Material material;
+  material.name = name;
+  return material;
+}
+
+//##################################################################################################
+std::vector<std::string> materialNames(const std::vector<tp_math_utils::Geometry3D>& object)
+{
+  std::vector<std::string> names;
+  for(const auto& mesh : object)
+    names.push_back(mesh.material.name.toString());
+  return names;
+}
+
+//##################################################################################################
+void testPatcher()
+{
+  std::string filePath = (std::filesystem::temp_directory_path() / "tp_boj_test_patch.boj").string();
+
+  std::vector<tp_math_utils::Geometry3D> object{scrambledGrid(6, 7), scrambledGrid(5, 8), scrambledGrid(4, 9)};
+  object.at(0).material = namedMaterial("a");
+  object.at(1).material = namedMaterial("b");
+  object.at(2).material = namedMaterial("a");
+  object.at(1).comments = {"one"};
+  writeFile(filePath, tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {}));
+
+  // Compaction is left to the test so that the unused chunks can be seen.
+  tp_boj::PatchOptions patchOptions;
+  patchOptions.maxUnusedRatio = 1.0f;
+
+  {
+    tp_boj::BOJPatcher patcher(filePath, patchOptions);
+    check(patcher.isValid() && patcher.meshCount()==3 && patcher.materialCount()==2, "patcher open");
+
+    check(patcher.setMeshComments(1, {"two", "three"}), "patcher set comments");
+    auto patched = tp_boj::deserializeObject(readFile(filePath));
+    check(patched.size()==3 && patched.at(1).comments==std::vector<std::string>{"two", "three"} && patched.at(0).comments.empty(), "patcher read comments");
+
+    // An existing material is shared, a new one is added to the material table.
+    check(patcher.setMeshMaterial(2, namedMaterial("b")) && patcher.materialCount()==2, "patcher set existing material");
+    check(patcher.setMeshMaterial(0, namedMaterial("c")) && patcher.materialCount()==3, "patcher set new material");
+    patched = tp_boj::deserializeObject(readFile(filePath));
+    check(materialNames(patched)==std::vector<std::string>{"c", "b", "b"}, "patcher read mesh materials");
+    check(patched.at(1).comments==std::vector<std::string>{"two", "three"}, "patcher keeps comments");
+
+    // Replacing a material changes every mesh that uses it.
+    check(patcher.setMaterial(1, namedMaterial("d")), "patcher set material");
+    patched = tp_boj::deserializeObject(readFile(filePath));
+    check(materialNames(patched)==std::vector<std::string>{"c", "d", "d"}, "patcher read material");
+    check(patcher.unusedBytes()>0, "patcher unused bytes");
+
+    // Compacting gives the same file as writing the patched object from scratch.
+    for(size_t m=0; m<patched.size(); m++)
+      check(patched.at(m).verts.size()==object.at(m).verts.size() && patched.at(m).indexes.size()==object.at(m).indexes.size(), "patcher keeps geometry " + std::to_string(m));
+    check(patcher.compact() && patcher.unusedBytes()==0 && patcher.materialCount()==2, "patcher compact");
+    std::string expected = tp_boj::serializeObject(patched, [](const auto&){}, [](const auto&, const auto&){}, {});
+    check(readFile(filePath)==expected, "patcher compact matches write");
+  }
+
+  // Older files don't have the tables that the patcher relies on.
+  std::string data = readFile(filePath);
+  uint32_t version = uint32_t(0)-28;
+  std::memcpy(data.data(), &version, sizeof(version));
+  writeFile(filePath, data);
+  {
+    tp_boj::BOJPatcher patcher(filePath, patchOptions);
+    check(!patcher.isValid() && !patcher.setMeshComments(0, {}), "patcher rejects version 28");
+    check(readFile(filePath)==data, "patcher leaves version 28 unchanged");
+  }
+
+  std::filesystem::remove(filePath);
+}
+
+//##################################################################################################
+template<typename T>
+T loadValue(const std::string& data, size_t offset)
+{
+  T value;
+  std::memcpy(&value, data.data()+offset, sizeof(T));
+  return value;
+}
+
+//##################################################################################################
+template<typename T>
+void storeValue(std::string& data, size_t offset, T value)
+{
+  std::memcpy(data.data()+offset, &value, sizeof(T));
+}
+
+//##################################################################################################
+//! Returns true if reading the data fails with the expected error.
+bool failsWith(const std::string& data, size_t maxThreads, size_t offset, size_t meshIndex, const std::string& reason)
+{
+  tp_boj::ReadError error;
+  tp_boj::ReadOptions readOptions;
+  readOptions.maxThreads = maxThreads;
+  readOptions.error = &error;
+  bool ok = tp_boj::deserializeObject(data.data(), data.size(), readOptions, [](tp_math_utils::Geometry3D&){return true;});
+  return !ok && error.offset==offset && error.meshIndex==meshIndex && error.reason==reason;
+}
+
+//##################################################################################################
+void testValidation()
+{
+  std::vector<tp_math_utils::Geometry3D> object{scrambledGrid(6, 10), scrambledGrid(5, 11), scrambledGrid(4, 12)};
+  object.at(1).material.name = "b";
+  std::string data = tp_boj::serializeObject(object, [](const auto&){}, [](const auto&, const auto&){}, {});
+
+  // Each mesh table entry is the offset and size of the geometry and then of the metadata.
+  size_t meshTableOffset = size_t(loadValue<uint64_t>(data, 24));
+  size_t entry1 = meshTableOffset + 32;
+  size_t entry2 = meshTableOffset + 64;
+  size_t metadata1 = size_t(loadValue<uint64_t>(data, entry1+16));
+  size_t metadata2End = size_t(loadValue<uint64_t>(data, entry2+16) + loadValue<uint64_t>(data, entry2+24));
+
+  for(size_t maxThreads : {size_t(1), size_t(4)})
+  {
+    std::string threads = std::to_string(maxThreads);
+
+    // Errors in the mesh table are found while reading the header, before any mesh.
+    std::string truncated = data.substr(0, metadata2End-1);
+    check(failsWith(truncated, maxThreads, entry2+32, tp_boj::ReadError::noMesh, "BOJ mesh table out of range."), "validate truncated " + threads);
+
+    std::string badOffset = data;
+    storeValue<uint64_t>(badOffset, entry1, data.size()+1);
+    check(failsWith(badOffset, maxThreads, entry1+16, tp_boj::ReadError::noMesh, "BOJ mesh table out of range."), "validate table offset " + threads);
+
+    std::string badMaterial = data;
+    storeValue<uint32_t>(badMaterial, metadata1, 2);
+    check(failsWith(badMaterial, maxThreads, metadata1+4, 1, "BOJ material index out of range."), "validate material index " + threads);
+  }
+}
+
+}
+
+//##################################################################################################
+int main()
+{
+  testRoundTrip();
+  testSelectiveReads();
+  testCompressionRoundTrip();
+  testCompressionRejectsInvalid();
+  testIndexPacking();
+  testOptimizeMeshes();
+  testSharedMaterials();
+  testWriteFile();
+  testResourceStats();
+  testStats();
+  testTruncated();
+  testCallbackExceptions();
+  testBatchReader();
+  testModelCache();
+  testRenderMeshes();
+  testBOJInfo();
+  testLODs();
+  testOptimizedLODs();
+  testBOJView();
+  testPatcher();
+  testValidation();
+
+  if(failures)
+  {
+    printf("%zu checks failed.\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,4 @@
+TARGET = tp_boj_test
+TEMPLATE = app
+
+SOURCES += src/main.cpp
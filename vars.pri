@@ -8,6 +8,32 @@ HEADERS += inc/tp_boj/Globals.h
 
 SOURCES += src/ReadBOJ.cpp
 HEADERS += inc/tp_boj/ReadBOJ.h
+HEADERS += src/ReadBOJPrivate.h
+
+SOURCES += src/BOJView.cpp
+HEADERS += inc/tp_boj/BOJView.h
+
+SOURCES += src/BatchReadBOJ.cpp
+HEADERS += inc/tp_boj/BatchReadBOJ.h
+
+SOURCES += src/ModelCache.cpp
+HEADERS += inc/tp_boj/ModelCache.h
+
+SOURCES += src/BOJInfo.cpp
+HEADERS += inc/tp_boj/BOJInfo.h
 
 SOURCES += src/WriteBOJ.cpp
 HEADERS += inc/tp_boj/WriteBOJ.h
+HEADERS += src/WriteBOJPrivate.h
+
+SOURCES += src/PatchBOJ.cpp
+HEADERS += inc/tp_boj/PatchBOJ.h
+
+SOURCES += src/MappedFile.cpp
+HEADERS += inc/tp_boj/MappedFile.h
+
+SOURCES += src/Compression.cpp
+HEADERS += inc/tp_boj/Compression.h
+
+SOURCES += src/OptimizeMesh.cpp
+HEADERS += inc/tp_boj/OptimizeMesh.h